@@ -0,0 +1,25 @@
+/*
+ * Zherdev, 2021
+ */
+
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include "bytecode.h"
+
+#include <stdint.h>
+
+// Inserts BC_CHECK instructions so that no cell outside of a tape of
+// tape_size cells is accessed, for engines that run without guard pages.
+// A function is split into segments in which the head offset of every
+// instruction relative to the start of the segment is known statically,
+// a segment gets a single check of all cells it accesses at its start.
+// Balanced loops stay inside of their segment, so they are checked once
+// on entry instead of on every iteration. Loops that move the head and
+// scans start new segments. The check is left out when the range is
+// proven to be on the tape: the first segment starts at cell 0 and every
+// other one starts on a cell that has already been accessed.
+int8_t
+bc_program_insert_checks(struct bc_program *program, uint32_t tape_size);
+
+#endif // BOUNDS_H
\ No newline at end of file
@@ -0,0 +1,91 @@
+/*
+ * Zherdev, 2021
+ */
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "semantics.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum bc_opcode {
+    BC_ADD,              // cell[offset] += arg
+    BC_MOVE,             // head_pos += arg
+    BC_SELECT,           // func_pos += arg
+    BC_JZ,               // [ : jump to arg if cell == 0
+    BC_JNZ,              // ] : jump to arg if cell != 0
+    BC_INPUT,            // cell[offset] = getc()
+    BC_OUTPUT,           // putc(cell[offset])
+    BC_CALL,
+    BC_RETURN,
+    BC_SYS_CALL,
+    BC_SET,              // cell[offset] = arg
+    BC_MUL,              // cell[offset] += cell * arg
+    BC_SCAN,             // head_pos += arg until cell == 0
+    BC_TAIL_CALL,        // call that replaces the current function, from : ;
+    BC_CHECK,            // error unless cells arg..offset around the head are on the tape
+    BC_CALL_DIRECT,      // call of function arg, func_pos resolved statically
+    BC_TAIL_CALL_DIRECT, // tail call of function arg
+    BC_ADD_VEC,          // cells from offset on += vecs[arg]
+
+    BC_OPCODES_NUM
+};
+
+// Widest delta vector, one AVX2 register.
+#define BC_VEC_MAX_BYTES (32)
+
+// Deltas of a BC_ADD_VEC to cells consecutive cells, bytes is 4, 8, 16 or 32
+// so that a single load, add and store applies them.
+struct bc_vec {
+    uint8_t deltas[BC_VEC_MAX_BYTES];
+    int32_t cells;
+    int32_t bytes;
+};
+
+struct bc_instr {
+    uint8_t op;
+    int32_t arg;
+    int32_t offset;
+};
+
+struct bc_func {
+    struct bc_instr *code;
+    int32_t          code_len;
+    int32_t          code_max_len;
+};
+
+struct bc_program {
+    struct bc_func *funcs;
+    int32_t         funcs_num;
+    uint8_t         cell_size; // bytes per cell
+
+    struct bc_vec  *vecs;
+    int32_t         vecs_num;
+    int32_t         vecs_max_num;
+};
+
+int8_t
+bc_cell_size_from_bits(uint32_t bits, uint8_t *cell_size);
+
+int8_t
+bc_program_init(struct bc_program *program, const struct sem_tree *tree, uint8_t cell_size);
+
+void
+bc_program_free(struct bc_program *program);
+
+int8_t
+bc_program_fprint(struct bc_program *program, FILE *file);
+
+int8_t
+bc_func_emit(struct bc_func *func, enum bc_opcode op, int32_t arg);
+
+int8_t
+bc_func_relink(struct bc_func *func);
+
+// Returns the index of the added vector, -1 on error.
+int32_t
+bc_program_add_vec(struct bc_program *program, const struct bc_vec *vec);
+
+#endif // BYTECODE_H
\ No newline at end of file
@@ -0,0 +1,77 @@
+/*
+ * Zherdev, 2021
+ */
+
+#ifndef EVAL_H
+#define EVAL_H
+
+#include "bytecode.h"
+
+#include <stdint.h>
+
+// Cells of the tapes used ahead of time at most.
+#define BC_EVAL_TAPE_SIZE (1024)
+// Instructions an evaluation may run, the calls it makes included.
+#define BC_EVAL_STEPS (1 << 20)
+// Instructions all evaluations of a program may run together.
+#define BC_EVAL_TOTAL_STEPS (1 << 24)
+#define BC_EVAL_MAX_DEPTH (64)
+// Bytes of output a prefix may write.
+#define BC_EVAL_OUTPUT_SIZE (65536)
+
+// A function run ahead of time, pc is the next instruction to run. Only a
+// prefix writes output, into output.
+struct bc_eval_frame {
+    uint32_t *tape;
+    int64_t   head;
+    uint32_t  func_pos;
+    int32_t   pc;
+
+    uint8_t  *output;
+    int32_t   output_len;
+};
+
+// Runs functions of a program ahead of time. A function starts with a
+// zeroed tape, so one that reads no input returns the same code on every
+// call: it is worked out once and kept for all calls after. An evaluation
+// gives up at anything seen from the outside (input, output, sys calls),
+// at accesses outside of its tape, when it runs out of steps and when it
+// calls a function being evaluated, which would recurse forever. Those
+// calls are left to the run time.
+struct bc_eval {
+    const struct bc_program *program;
+    uint8_t                 *states;       // enum bc_eval_state by function
+    uint32_t                *return_codes; // by function, once known
+    int64_t                  steps;        // left for the current evaluation
+    int64_t                  total_steps;  // left for the evaluations to come
+    int32_t                  depth;
+    int32_t                  tape_size;    // cells of the tapes
+};
+
+// Evaluations get tapes of tape_size cells, as many as at run time, up to
+// BC_EVAL_TAPE_SIZE. A function that runs off a smaller tape is left to fail
+// at run time.
+int8_t
+bc_eval_init(struct bc_eval *eval, const struct bc_program *program, uint32_t tape_size);
+
+void
+bc_eval_free(struct bc_eval *eval);
+
+// Sets return_code to what a call of function index returns, -1 if it can
+// not be worked out ahead of time.
+int8_t
+bc_eval_call(struct bc_eval *eval, int32_t index, uint32_t *return_code);
+
+// Runs the main function ahead of time as far as it does not depend on the
+// outside: up to its first input, sys call or call that can not be worked
+// out, or its return. The output it writes on the way is collected. Frame
+// is left at the start of the outermost loop holding that instruction, so
+// the program resumes with the rest of its code from the frame. The frame
+// is allocated here, free it with bc_eval_frame_free().
+int8_t
+bc_eval_prefix(struct bc_eval *eval, struct bc_eval_frame *frame);
+
+void
+bc_eval_frame_free(struct bc_eval_frame *frame);
+
+#endif // EVAL_H
\ No newline at end of file
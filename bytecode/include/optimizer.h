@@ -0,0 +1,16 @@
+/*
+ * Zherdev, 2021
+ */
+
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "bytecode.h"
+
+#include <stdint.h>
+
+// Tape_size is the cells of a tape the program runs with.
+int8_t
+bc_program_optimize(struct bc_program *program, uint32_t tape_size);
+
+#endif // OPTIMIZER_H
\ No newline at end of file
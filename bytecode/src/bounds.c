@@ -0,0 +1,395 @@
+/*
+ * See bytecode/include/bounds.h for details.
+ *
+ * Zherdev, 2021
+ */
+
+#include "bounds.h"
+
+#include <stdlib.h>
+
+// Cells relative to the head, empty if lo > hi.
+struct bc_range {
+    int64_t lo;
+    int64_t hi;
+};
+
+static const struct bc_range bc_range_empty = {INT64_MAX, INT64_MIN};
+static const struct bc_range bc_range_head = {0, 0};
+
+struct bc_loop_state {
+    int32_t         start;
+    int64_t         net;
+    int8_t          balanced;
+    int8_t          visible;
+    struct bc_range body;   // accesses of the body until it is visible
+    struct bc_range known;  // cells known to be on the tape at the jz
+};
+
+// Per pc of a function: the loops found balanced and their accesses by the
+// pc of their jz, and the check to insert before the instruction, if its op
+// is BC_CHECK. A loop entry check is skipped by the jnz of its loop.
+struct bc_checks {
+    const struct bc_vec *vecs;
+    int8_t              *balanced;
+    struct bc_range     *bodies;
+    struct bc_instr     *code;
+    int8_t              *entry;
+    int32_t              code_len;
+};
+
+static void
+bc_range_add(struct bc_range *range, int64_t offset)
+{
+    if (offset < range->lo) {
+        range->lo = offset;
+    }
+    if (offset > range->hi) {
+        range->hi = offset;
+    }
+}
+
+static int8_t
+bc_range_covers(const struct bc_range *range, const struct bc_range *other)
+{
+    return other->lo > other->hi
+            || (range->lo <= other->lo && other->hi <= range->hi);
+}
+
+// Cells known to be on the tape stay there, two ranges that do not touch
+// cannot be merged and the newer one is kept.
+static void
+bc_range_merge(struct bc_range *range, const struct bc_range *other)
+{
+    if (range->lo > range->hi
+            || other->hi + 1 < range->lo
+            || range->hi + 1 < other->lo) {
+        *range = *other;
+        return;
+    }
+
+    bc_range_add(range, other->lo);
+    bc_range_add(range, other->hi);
+}
+
+// Instructions that are seen from the outside, a check must not fail ahead
+// of them.
+static int8_t
+bc_opcode_is_visible(uint8_t op)
+{
+    return op == BC_INPUT
+            || op == BC_OUTPUT
+            || op == BC_CALL
+            || op == BC_RETURN
+            || op == BC_TAIL_CALL
+            || op == BC_CALL_DIRECT
+            || op == BC_TAIL_CALL_DIRECT
+            || op == BC_SYS_CALL;
+}
+
+// Adds the cells accessed by instr with the head at offset to range. A call
+// writes its return code once the callee has run, that access belongs to
+// whatever follows it.
+static void
+bc_instr_accesses(
+        const struct bc_instr *instr,
+        const struct bc_vec   *vecs,
+        int64_t                offset,
+        struct bc_range       *range)
+{
+    switch (instr->op) {
+        case BC_MOVE:
+        case BC_SELECT:
+        case BC_CALL:
+        case BC_TAIL_CALL:
+        case BC_CALL_DIRECT:
+        case BC_TAIL_CALL_DIRECT:
+        case BC_CHECK:
+            break;
+
+        case BC_ADD:
+        case BC_SET:
+        case BC_INPUT:
+        case BC_OUTPUT:
+            bc_range_add(range, offset + instr->offset);
+            break;
+
+        // A multiplication only runs inside of its loop, the check of its
+        // cells goes behind the jz and is skipped with the loop.
+        case BC_MUL:
+            bc_range_add(range, offset);
+            bc_range_add(range, offset + instr->offset);
+            break;
+
+        case BC_ADD_VEC:
+            bc_range_add(range, offset + instr->offset);
+            bc_range_add(range, offset + instr->offset + vecs[instr->arg].cells - 1);
+            break;
+
+        default:
+            bc_range_add(range, offset);
+            break;
+    }
+}
+
+// A loop is balanced if its body has no net head movement, does not scan
+// and contains balanced loops only. The head offset of every instruction of
+// such a loop does not depend on the iteration, so the cells its body
+// accesses are collected for a single check on entry. The collection stops
+// at the first instruction seen from the outside, in the body or in a
+// nested loop, the rest is checked block by block.
+static int8_t
+bc_func_find_balanced_loops(const struct bc_func *func, struct bc_checks *checks)
+{
+    struct bc_loop_state *stack = calloc(func->code_len + 1, sizeof(*stack));
+    if (!stack) {
+        return -1;
+    }
+    int32_t stack_len = 1;
+
+    for (int32_t pc = 0; pc < func->code_len; pc++) {
+        const struct bc_instr *instr = &func->code[pc];
+        struct bc_loop_state *top = &stack[stack_len - 1];
+
+        if (!top->visible) {
+            bc_instr_accesses(instr, checks->vecs, top->net, &top->body);
+        }
+
+        if (instr->op == BC_MOVE) {
+            top->net += instr->arg;
+        } else if (instr->op == BC_SCAN) {
+            top->balanced = 0;
+        } else if (bc_opcode_is_visible(instr->op)) {
+            top->visible = 1;
+        } else if (instr->op == BC_JZ) {
+            struct bc_loop_state *loop = &stack[stack_len++];
+            loop->start = pc;
+            loop->net = 0;
+            loop->balanced = 1;
+            loop->visible = 0;
+            loop->body = bc_range_empty;
+        } else if (instr->op == BC_JNZ) {
+            if (stack_len < 2) {
+                free(stack);
+                return -1;
+            }
+
+            int8_t balanced = top->balanced && top->net == 0;
+            checks->balanced[top->start] = balanced;
+            checks->bodies[top->start] = top->body;
+
+            stack_len--;
+            if (!balanced) {
+                stack[stack_len - 1].balanced = 0;
+            }
+            if (top->visible) {
+                stack[stack_len - 1].visible = 1;
+            }
+        }
+    }
+
+    free(stack);
+
+    return 0;
+}
+
+static void
+bc_checks_add(struct bc_checks *checks, int32_t pc, const struct bc_range *range)
+{
+    struct bc_instr *check = &checks->code[pc];
+
+    // A range that does not fit into int32_t is wider than any tape, the
+    // clamped one fails the same way.
+    int64_t lo = range->lo < INT32_MIN ? INT32_MIN : range->lo;
+    int64_t hi = range->hi > INT32_MAX ? INT32_MAX : range->hi;
+
+    if (check->op == BC_CHECK) {
+        lo = check->arg < lo ? check->arg : lo;
+        hi = check->offset > hi ? check->offset : hi;
+    } else {
+        checks->code_len++;
+    }
+
+    check->op = BC_CHECK;
+    check->arg = lo;
+    check->offset = hi;
+}
+
+// Walks the basic blocks of the function with the range of cells around
+// the head known to be on the tape: the whole tape at the start, the cell
+// under the head after it was accessed, what a check or the entry of a
+// balanced loop proved. A block that accesses anything else gets a check.
+// Blocks end at loops, scans and the instructions that are seen from the
+// outside, so a check never fails ahead of them.
+static int8_t
+bc_func_find_checks(const struct bc_func *func, uint32_t tape_size, struct bc_checks *checks)
+{
+    struct bc_loop_state *stack = calloc(func->code_len + 1, sizeof(*stack));
+    if (!stack) {
+        return -1;
+    }
+    int32_t stack_len = 0;
+
+    struct bc_range known = {0, (int64_t) tape_size - 1};
+    struct bc_range block = bc_range_empty;
+    int32_t block_start = 0;
+    int64_t head = 0;
+
+    for (int32_t pc = 0; pc < func->code_len; pc++) {
+        const struct bc_instr *instr = &func->code[pc];
+
+        bc_instr_accesses(instr, checks->vecs, head, &block);
+        if (instr->op == BC_MOVE) {
+            head += instr->arg;
+            continue;
+        }
+
+        if (instr->op != BC_JZ
+                && instr->op != BC_JNZ
+                && instr->op != BC_SCAN
+                && !bc_opcode_is_visible(instr->op)) {
+            continue;
+        }
+
+        if (!bc_range_covers(&known, &block)) {
+            bc_checks_add(checks, block_start, &block);
+            bc_range_merge(&known, &block);
+        }
+        known.lo -= head;
+        known.hi -= head;
+
+        if (instr->op == BC_JZ) {
+            struct bc_loop_state *loop = &stack[stack_len++];
+            loop->known = known;
+
+            if (!checks->balanced[pc]) {
+                known = bc_range_head;
+            } else if (!bc_range_covers(&known, &checks->bodies[pc])) {
+                bc_checks_add(checks, pc + 1, &checks->bodies[pc]);
+                checks->entry[pc + 1] = 1;
+                bc_range_merge(&known, &checks->bodies[pc]);
+            }
+        } else if (instr->op == BC_JNZ) {
+            if (stack_len < 1) {
+                free(stack);
+                return -1;
+            }
+
+            // The head of a balanced loop is back where it entered, the
+            // cells known then are still on the tape.
+            struct bc_loop_state *loop = &stack[--stack_len];
+            known = checks->balanced[instr->arg - 1] ? loop->known : bc_range_head;
+        } else if (instr->op == BC_SCAN) {
+            known = bc_range_head;
+        }
+
+        block = bc_range_empty;
+        block_start = pc + 1;
+        head = 0;
+
+        if (instr->op == BC_CALL || instr->op == BC_CALL_DIRECT) {
+            bc_range_add(&block, 0);
+        }
+    }
+
+    if (!bc_range_covers(&known, &block)) {
+        bc_checks_add(checks, block_start, &block);
+    }
+
+    free(stack);
+
+    return 0;
+}
+
+static int8_t
+bc_func_place_checks(struct bc_func *func, const struct bc_checks *checks)
+{
+    if (checks->code_len == 0) {
+        return 0;
+    }
+
+    int32_t len = func->code_len + checks->code_len;
+    struct bc_instr *code = calloc(len, sizeof(*code));
+    int8_t *entry = calloc(len, sizeof(*entry));
+    if (!code || !entry) {
+        free(code);
+        free(entry);
+        return -1;
+    }
+
+    int32_t new_len = 0;
+    for (int32_t pc = 0; pc < func->code_len; pc++) {
+        if (checks->code[pc].op == BC_CHECK) {
+            entry[new_len] = checks->entry[pc];
+            code[new_len++] = checks->code[pc];
+        }
+        code[new_len++] = func->code[pc];
+    }
+
+    free(func->code);
+    func->code = code;
+    func->code_len = len;
+    func->code_max_len = len;
+
+    int8_t err = bc_func_relink(func);
+    if (!err) {
+        // Later iterations of a loop with an entry check go right behind it.
+        for (int32_t pc = 0; pc + 1 < len; pc++) {
+            if (code[pc].op == BC_JZ && entry[pc + 1]) {
+                code[code[pc].arg - 1].arg = pc + 2;
+            }
+        }
+    }
+
+    free(entry);
+
+    return err;
+}
+
+static int8_t
+bc_func_insert_checks(struct bc_func *func, const struct bc_vec *vecs, uint32_t tape_size)
+{
+    struct bc_checks checks = {0};
+    int32_t len = func->code_len + 1;
+    int8_t err = -1;
+
+    checks.vecs = vecs;
+    checks.balanced = calloc(len, sizeof(*checks.balanced));
+    checks.bodies = calloc(len, sizeof(*checks.bodies));
+    checks.code = calloc(len, sizeof(*checks.code));
+    checks.entry = calloc(len, sizeof(*checks.entry));
+
+    if (checks.balanced && checks.bodies && checks.code && checks.entry) {
+        err = bc_func_find_balanced_loops(func, &checks);
+    }
+    if (!err) {
+        err = bc_func_find_checks(func, tape_size, &checks);
+    }
+    if (!err) {
+        err = bc_func_place_checks(func, &checks);
+    }
+
+    free(checks.balanced);
+    free(checks.bodies);
+    free(checks.code);
+    free(checks.entry);
+
+    return err;
+}
+
+int8_t
+bc_program_insert_checks(struct bc_program *program, uint32_t tape_size)
+{
+    if (!program) {
+        return -1;
+    }
+
+    for (int32_t i = 0; i < program->funcs_num; i++) {
+        int8_t err = bc_func_insert_checks(&program->funcs[i], program->vecs, tape_size);
+        if (err) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
\ No newline at end of file
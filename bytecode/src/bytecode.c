@@ -0,0 +1,396 @@
+/*
+ * See bytecode/include/bytecode.h for details.
+ *
+ * Zherdev, 2021
+ */
+
+#include "bytecode.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+static int8_t
+bc_func_init(struct bc_func *func)
+{
+    const int32_t default_code_len = 64;
+
+    func->code = calloc(default_code_len, sizeof(*func->code));
+    if (!func->code) {
+        return -1;
+    }
+
+    func->code_len = 0;
+    func->code_max_len = default_code_len;
+
+    return 0;
+}
+
+static void
+bc_func_free(struct bc_func *func)
+{
+    if (!func) {
+        return;
+    }
+
+    free(func->code);
+    func->code = NULL;
+    func->code_len = 0;
+    func->code_max_len = 0;
+}
+
+int8_t
+bc_func_emit(struct bc_func *func, enum bc_opcode op, int32_t arg)
+{
+    if (!func) {
+        return -1;
+    }
+
+    if (func->code_len >= func->code_max_len) {
+        int32_t new_size = func->code_max_len * 2;
+
+        struct bc_instr *code = realloc(func->code, new_size * sizeof(*code));
+        if (!code) {
+            return -1;
+        }
+
+        func->code = code;
+        func->code_max_len = new_size;
+    }
+
+    struct bc_instr *instr = &func->code[func->code_len++];
+    instr->op = op;
+    instr->arg = arg;
+    instr->offset = 0;
+
+    return 0;
+}
+
+int8_t
+bc_func_relink(struct bc_func *func)
+{
+    if (!func) {
+        return -1;
+    }
+
+    int32_t *stack = calloc(func->code_len + 1, sizeof(*stack));
+    if (!stack) {
+        return -1;
+    }
+    int32_t stack_len = 0;
+
+    for (int32_t pc = 0; pc < func->code_len; pc++) {
+        struct bc_instr *instr = &func->code[pc];
+
+        if (instr->op == BC_JZ) {
+            stack[stack_len++] = pc;
+        } else if (instr->op == BC_JNZ) {
+            if (stack_len == 0) {
+                free(stack);
+                return -1;
+            }
+
+            int32_t start = stack[--stack_len];
+            func->code[start].arg = pc + 1;
+            instr->arg = start + 1;
+        }
+    }
+
+    free(stack);
+
+    return stack_len == 0 ? 0 : -1;
+}
+
+static int8_t
+bc_action_to_instr(enum sem_node_type action, enum bc_opcode *op, int32_t *arg)
+{
+    *arg = 0;
+
+    switch (action) {
+        case SEM_ACTION_INC:
+            *op = BC_ADD;
+            *arg = 1;
+            break;
+
+        case SEM_ACTION_DEC:
+            *op = BC_ADD;
+            *arg = -1;
+            break;
+
+        case SEM_ACTION_LEFT:
+            *op = BC_MOVE;
+            *arg = -1;
+            break;
+
+        case SEM_ACTION_RIGHT:
+            *op = BC_MOVE;
+            *arg = 1;
+            break;
+
+        case SEM_ACTION_INPUT:
+            *op = BC_INPUT;
+            break;
+
+        case SEM_ACTION_OUTPUT:
+            *op = BC_OUTPUT;
+            break;
+
+        case SEM_ACTION_UP:
+            *op = BC_SELECT;
+            *arg = -1;
+            break;
+
+        case SEM_ACTION_DOWN:
+            *op = BC_SELECT;
+            *arg = 1;
+            break;
+
+        case SEM_ACTION_FUNC_CALL:
+            *op = BC_CALL;
+            break;
+
+        case SEM_ACTION_RETURN:
+            *op = BC_RETURN;
+            break;
+
+        case SEM_ACTION_SYS_CALL:
+            *op = BC_SYS_CALL;
+            break;
+
+        default:
+            return -1;
+            break;
+    }
+
+    return 0;
+}
+
+static int8_t
+bc_func_lower_leaves(struct bc_func *func, const struct sem_tree *tree, int32_t node);
+
+static int8_t
+bc_func_lower_cyc(struct bc_func *func, const struct sem_tree *tree, int32_t cyc)
+{
+    int32_t start = func->code_len;
+    int8_t err = bc_func_emit(func, BC_JZ, 0);
+    if (err) {
+        return -1;
+    }
+
+    err = bc_func_lower_leaves(func, tree, cyc);
+    if (err) {
+        return -1;
+    }
+
+    err = bc_func_emit(func, BC_JNZ, start + 1);
+    if (err) {
+        return -1;
+    }
+    func->code[start].arg = func->code_len;
+
+    return 0;
+}
+
+static int8_t
+bc_func_lower_leaves(struct bc_func *func, const struct sem_tree *tree, int32_t node)
+{
+    int32_t end = sem_tree_next(tree, node);
+
+    for (int32_t i = node + 1; i < end; i = sem_tree_next(tree, i)) {
+        enum sem_node_type type = tree->nodes[i].type;
+
+        if (type == SEM_CYC) {
+            int8_t err = bc_func_lower_cyc(func, tree, i);
+            if (err) {
+                return -1;
+            }
+            continue;
+        }
+
+        if (!sem_node_is_action(type)) {
+            continue;
+        }
+
+        enum bc_opcode op = 0;
+        int32_t arg = 0;
+        int8_t err = bc_action_to_instr(type, &op, &arg);
+        if (err) {
+            return -1;
+        }
+
+        err = bc_func_emit(func, op, arg);
+        if (err) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int8_t
+bc_func_lower(struct bc_func *func, const struct sem_tree *tree, int32_t sem_func)
+{
+    int8_t err = bc_func_init(func);
+    if (err) {
+        return -1;
+    }
+
+    err = bc_func_lower_leaves(func, tree, sem_func);
+    if (err) {
+        return -1;
+    }
+
+    // Falling off the end of a function is an implicit return.
+    return bc_func_emit(func, BC_RETURN, 0);
+}
+
+int8_t
+bc_cell_size_from_bits(uint32_t bits, uint8_t *cell_size)
+{
+    if (!cell_size || (bits != 8 && bits != 16 && bits != 32)) {
+        return -1;
+    }
+
+    *cell_size = bits / 8;
+
+    return 0;
+}
+
+int8_t
+bc_program_init(struct bc_program *program, const struct sem_tree *tree, uint8_t cell_size)
+{
+    if (!program || !tree || tree->nodes_num == 0 || tree->nodes[0].type != SEM_ROOT) {
+        return -1;
+    }
+    if (cell_size != 1 && cell_size != 2 && cell_size != 4) {
+        return -1;
+    }
+
+    program->funcs = NULL;
+    program->funcs_num = 0;
+    program->cell_size = cell_size;
+    program->vecs = NULL;
+    program->vecs_num = 0;
+    program->vecs_max_num = 0;
+
+    int32_t funcs_num = 0;
+    for (int32_t i = 1; i < tree->nodes_num; i = sem_tree_next(tree, i)) {
+        funcs_num++;
+    }
+    if (funcs_num == 0) {
+        return 0;
+    }
+
+    program->funcs = calloc(funcs_num, sizeof(*program->funcs));
+    if (!program->funcs) {
+        return -1;
+    }
+    program->funcs_num = funcs_num;
+
+    int32_t sem_func = 1;
+    for (int32_t i = 0; i < funcs_num; i++) {
+        int8_t err = bc_func_lower(&program->funcs[i], tree, sem_func);
+        if (err) {
+            bc_program_free(program);
+            return -1;
+        }
+        sem_func = sem_tree_next(tree, sem_func);
+    }
+
+    return 0;
+}
+
+void
+bc_program_free(struct bc_program *program)
+{
+    if (!program) {
+        return;
+    }
+
+    for (int32_t i = 0; i < program->funcs_num; i++) {
+        bc_func_free(&program->funcs[i]);
+    }
+
+    free(program->funcs);
+    program->funcs = NULL;
+    program->funcs_num = 0;
+
+    free(program->vecs);
+    program->vecs = NULL;
+    program->vecs_num = 0;
+    program->vecs_max_num = 0;
+}
+
+int32_t
+bc_program_add_vec(struct bc_program *program, const struct bc_vec *vec)
+{
+    if (!program || !vec) {
+        return -1;
+    }
+
+    if (program->vecs_num >= program->vecs_max_num) {
+        int32_t new_size = program->vecs_max_num * 2 + 16;
+
+        struct bc_vec *vecs = realloc(program->vecs, new_size * sizeof(*vecs));
+        if (!vecs) {
+            return -1;
+        }
+
+        program->vecs = vecs;
+        program->vecs_max_num = new_size;
+    }
+
+    program->vecs[program->vecs_num] = *vec;
+
+    return program->vecs_num++;
+}
+
+static const char *bc_opcode_names[BC_OPCODES_NUM] = {
+    [BC_ADD]              = "add",
+    [BC_MOVE]             = "move",
+    [BC_SELECT]           = "select",
+    [BC_JZ]               = "jz",
+    [BC_JNZ]              = "jnz",
+    [BC_INPUT]            = "input",
+    [BC_OUTPUT]           = "output",
+    [BC_CALL]             = "call",
+    [BC_RETURN]           = "return",
+    [BC_SYS_CALL]         = "syscall",
+    [BC_SET]              = "set",
+    [BC_MUL]              = "mul",
+    [BC_SCAN]             = "scan",
+    [BC_TAIL_CALL]        = "tailcall",
+    [BC_CHECK]            = "check",
+    [BC_CALL_DIRECT]      = "calldirect",
+    [BC_TAIL_CALL_DIRECT] = "tailcalldirect",
+    [BC_ADD_VEC]          = "addvec",
+};
+
+int8_t
+bc_program_fprint(struct bc_program *program, FILE *file)
+{
+    if (!program || !file) {
+        return -1;
+    }
+
+    for (int32_t i = 0; i < program->funcs_num; i++) {
+        struct bc_func *func = &program->funcs[i];
+
+        if (fprintf(file, "func %d:\n", i) < 0) {
+            return -1;
+        }
+
+        for (int32_t pc = 0; pc < func->code_len; pc++) {
+            struct bc_instr *instr = &func->code[pc];
+
+            int32_t res = fprintf(
+                    file,
+                    "    %4d  %-14s %d @%d\n",
+                    pc, bc_opcode_names[instr->op], instr->arg, instr->offset);
+            if (res < 0) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,392 @@
+/*
+ * See bytecode/include/eval.h for details.
+ *
+ * Zherdev, 2021
+ */
+
+#include "eval.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum bc_eval_state {
+    BC_EVAL_UNKNOWN,
+    BC_EVAL_BUSY,
+    BC_EVAL_DONE,
+    BC_EVAL_FAILED,
+};
+
+int8_t
+bc_eval_init(struct bc_eval *eval, const struct bc_program *program, uint32_t tape_size)
+{
+    if (!eval || !program || tape_size == 0) {
+        return -1;
+    }
+
+    eval->program = program;
+    eval->steps = 0;
+    eval->total_steps = BC_EVAL_TOTAL_STEPS;
+    eval->depth = 0;
+    eval->tape_size = tape_size < BC_EVAL_TAPE_SIZE ? (int32_t) tape_size : BC_EVAL_TAPE_SIZE;
+
+    eval->states = calloc(program->funcs_num + 1, sizeof(*eval->states));
+    eval->return_codes = calloc(program->funcs_num + 1, sizeof(*eval->return_codes));
+    if (!eval->states || !eval->return_codes) {
+        bc_eval_free(eval);
+        return -1;
+    }
+
+    return 0;
+}
+
+void
+bc_eval_free(struct bc_eval *eval)
+{
+    if (!eval) {
+        return;
+    }
+
+    free(eval->states);
+    eval->states = NULL;
+    free(eval->return_codes);
+    eval->return_codes = NULL;
+}
+
+// Cells are kept in uint32_t and wrapped to the cell width by mask.
+static uint32_t
+bc_eval_mask(uint8_t cell_size)
+{
+    return cell_size == 4 ? UINT32_MAX : ((uint32_t) 1 << (8 * cell_size)) - 1;
+}
+
+static uint32_t *
+bc_eval_cell(const struct bc_eval *eval, uint32_t *tape, int64_t pos)
+{
+    if (pos < 0 || pos >= eval->tape_size) {
+        return NULL;
+    }
+
+    return &tape[pos];
+}
+
+// Runs function index from the frame until it returns, with the return
+// code then, or up to the first instruction it can not run or stop_pc. The
+// frame is left at that instruction, nothing of it is done.
+static int8_t
+bc_eval_run(
+        struct bc_eval       *eval,
+        int32_t               index,
+        struct bc_eval_frame *frame,
+        int32_t               stop_pc,
+        uint32_t             *return_code)
+{
+    const struct bc_program *program = eval->program;
+    const struct bc_func *func = &program->funcs[index];
+    uint32_t mask = bc_eval_mask(program->cell_size);
+    uint32_t *tape = frame->tape;
+
+    while (frame->pc < func->code_len && frame->pc != stop_pc) {
+        const struct bc_instr *instr = &func->code[frame->pc];
+        int32_t next = frame->pc + 1;
+        int64_t head = frame->head;
+        uint32_t *cell = NULL;
+        uint32_t *other = NULL;
+
+        if (--eval->steps < 0) {
+            return -1;
+        }
+
+        switch (instr->op) {
+            case BC_ADD:
+                other = bc_eval_cell(eval, tape, head + instr->offset);
+                if (!other) {
+                    return -1;
+                }
+                *other = (*other + (uint32_t) instr->arg) & mask;
+                break;
+
+            case BC_MOVE:
+                frame->head += instr->arg;
+                break;
+
+            case BC_SELECT:
+                frame->func_pos += instr->arg;
+                break;
+
+            case BC_JZ:
+            case BC_JNZ:
+                cell = bc_eval_cell(eval, tape, head);
+                if (!cell) {
+                    return -1;
+                }
+                if ((*cell == 0) == (instr->op == BC_JZ)) {
+                    next = instr->arg;
+                }
+                break;
+
+            case BC_OUTPUT:
+                other = bc_eval_cell(eval, tape, head + instr->offset);
+                if (!other || !frame->output || frame->output_len >= BC_EVAL_OUTPUT_SIZE) {
+                    return -1;
+                }
+                frame->output[frame->output_len++] = *other;
+                break;
+
+            case BC_CALL:
+            case BC_CALL_DIRECT:
+            case BC_TAIL_CALL:
+            case BC_TAIL_CALL_DIRECT:
+            {
+                int8_t direct = instr->op == BC_CALL_DIRECT || instr->op == BC_TAIL_CALL_DIRECT;
+                uint32_t callee = direct ? (uint32_t) instr->arg : frame->func_pos;
+                cell = bc_eval_cell(eval, tape, head);
+                if (!cell || callee >= (uint32_t) program->funcs_num) {
+                    return -1;
+                }
+
+                uint32_t value = 0;
+                int8_t err = bc_eval_call(eval, callee, &value);
+                if (err) {
+                    return -1;
+                }
+
+                if (instr->op == BC_TAIL_CALL || instr->op == BC_TAIL_CALL_DIRECT) {
+                    *return_code = value;
+                    return 0;
+                }
+                *cell = value;
+                break;
+            }
+
+            case BC_RETURN:
+                cell = bc_eval_cell(eval, tape, head);
+                if (!cell) {
+                    return -1;
+                }
+                *return_code = *cell;
+                return 0;
+
+            case BC_SET:
+                other = bc_eval_cell(eval, tape, head + instr->offset);
+                if (!other) {
+                    return -1;
+                }
+                *other = (uint32_t) instr->arg & mask;
+                break;
+
+            case BC_MUL:
+                cell = bc_eval_cell(eval, tape, head);
+                other = bc_eval_cell(eval, tape, head + instr->offset);
+                if (!cell || !other) {
+                    return -1;
+                }
+                *other = (*other + *cell * (uint32_t) instr->arg) & mask;
+                break;
+
+            case BC_SCAN:
+                cell = bc_eval_cell(eval, tape, head);
+                while (cell && *cell) {
+                    if (--eval->steps < 0) {
+                        return -1;
+                    }
+                    head += instr->arg;
+                    cell = bc_eval_cell(eval, tape, head);
+                }
+                if (!cell) {
+                    return -1;
+                }
+                frame->head = head;
+                break;
+
+            case BC_ADD_VEC:
+            {
+                const struct bc_vec *vec = &program->vecs[instr->arg];
+                int64_t first = head + instr->offset;
+                if (!bc_eval_cell(eval, tape, first) || !bc_eval_cell(eval, tape, first + vec->cells - 1)) {
+                    return -1;
+                }
+
+                // It costs as much as the adds it replaced.
+                eval->steps -= vec->cells - 1;
+                if (eval->steps < 0) {
+                    return -1;
+                }
+
+                for (int32_t i = 0; i < vec->cells; i++) {
+                    uint32_t delta = 0;
+                    for (int32_t j = 0; j < program->cell_size; j++) {
+                        delta |= (uint32_t) vec->deltas[i * program->cell_size + j] << (8 * j);
+                    }
+                    tape[first + i] = (tape[first + i] + delta) & mask;
+                }
+                break;
+            }
+
+            // Every access is checked above.
+            case BC_CHECK:
+                break;
+
+            default:
+                return -1;
+                break;
+        }
+
+        frame->pc = next;
+    }
+
+    return -1;
+}
+
+// The outermost evaluation gets its share of the steps left, the calls it
+// makes take theirs from it.
+static int64_t
+bc_eval_enter(struct bc_eval *eval)
+{
+    int64_t steps = 0;
+    if (eval->depth == 0) {
+        steps = eval->total_steps < BC_EVAL_STEPS ? eval->total_steps : BC_EVAL_STEPS;
+        eval->steps = steps;
+    }
+    eval->depth++;
+
+    return steps;
+}
+
+static void
+bc_eval_leave(struct bc_eval *eval, int64_t steps)
+{
+    eval->depth--;
+    if (eval->depth == 0) {
+        eval->total_steps -= eval->steps > 0 ? steps - eval->steps : steps;
+    }
+}
+
+int8_t
+bc_eval_call(struct bc_eval *eval, int32_t index, uint32_t *return_code)
+{
+    if (!eval || !return_code || index < 0 || index >= eval->program->funcs_num) {
+        return -1;
+    }
+
+    switch (eval->states[index]) {
+        case BC_EVAL_DONE:
+            *return_code = eval->return_codes[index];
+            return 0;
+            break;
+
+        case BC_EVAL_BUSY:
+        case BC_EVAL_FAILED:
+            return -1;
+            break;
+
+        default:
+            break;
+    }
+
+    if (eval->depth >= BC_EVAL_MAX_DEPTH) {
+        return -1;
+    }
+
+    struct bc_eval_frame frame = {0};
+    frame.tape = calloc(eval->tape_size, sizeof(*frame.tape));
+    if (!frame.tape) {
+        return -1;
+    }
+
+    eval->states[index] = BC_EVAL_BUSY;
+    int64_t steps = bc_eval_enter(eval);
+    int8_t err = bc_eval_run(eval, index, &frame, -1, &eval->return_codes[index]);
+    bc_eval_leave(eval, steps);
+    eval->states[index] = err ? BC_EVAL_FAILED : BC_EVAL_DONE;
+
+    free(frame.tape);
+
+    if (err) {
+        return -1;
+    }
+
+    *return_code = eval->return_codes[index];
+
+    return 0;
+}
+
+static void
+bc_eval_frame_reset(const struct bc_eval *eval, struct bc_eval_frame *frame)
+{
+    memset(frame->tape, 0, eval->tape_size * sizeof(*frame->tape));
+    frame->head = 0;
+    frame->func_pos = 0;
+    frame->pc = 0;
+    frame->output_len = 0;
+}
+
+// Runs main until it stops or reaches stop_pc, returns the pc it is left at.
+static int32_t
+bc_eval_main(struct bc_eval *eval, struct bc_eval_frame *frame, int32_t stop_pc)
+{
+    uint32_t return_code = 0;
+
+    bc_eval_frame_reset(eval, frame);
+
+    int64_t steps = bc_eval_enter(eval);
+    bc_eval_run(eval, 0, frame, stop_pc, &return_code);
+    bc_eval_leave(eval, steps);
+
+    return frame->pc;
+}
+
+// Top level code runs once, so the program reaches the start of a top
+// level loop with the same frame on a second run. The loop holding the
+// instruction main stopped at is run again from there by the run time.
+int8_t
+bc_eval_prefix(struct bc_eval *eval, struct bc_eval_frame *frame)
+{
+    if (!eval || !frame || eval->program->funcs_num == 0) {
+        return -1;
+    }
+
+    memset(frame, 0, sizeof(*frame));
+    frame->tape = calloc(eval->tape_size, sizeof(*frame->tape));
+    frame->output = malloc(BC_EVAL_OUTPUT_SIZE);
+    if (!frame->tape || !frame->output) {
+        bc_eval_frame_free(frame);
+        return -1;
+    }
+
+    const struct bc_func *main_func = &eval->program->funcs[0];
+    int32_t stop = bc_eval_main(eval, frame, -1);
+
+    int32_t resume = 0;
+    int32_t depth = 0;
+    for (int32_t pc = 0; pc <= stop && pc < main_func->code_len; pc++) {
+        if (depth == 0) {
+            resume = pc;
+        }
+
+        if (main_func->code[pc].op == BC_JZ) {
+            depth++;
+        } else if (main_func->code[pc].op == BC_JNZ) {
+            depth--;
+        }
+    }
+
+    if (resume != stop && bc_eval_main(eval, frame, resume) != resume) {
+        bc_eval_frame_free(frame);
+        return -1;
+    }
+
+    return 0;
+}
+
+void
+bc_eval_frame_free(struct bc_eval_frame *frame)
+{
+    if (!frame) {
+        return;
+    }
+
+    free(frame->tape);
+    frame->tape = NULL;
+    free(frame->output);
+    frame->output = NULL;
+}
\ No newline at end of file
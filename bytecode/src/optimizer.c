@@ -0,0 +1,705 @@
+/*
+ * See bytecode/include/optimizer.h for details.
+ *
+ * Zherdev, 2021
+ */
+
+#include "optimizer.h"
+#include "eval.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BC_LOOP_MAX_CELLS (32)
+#define BC_VEC_MIN_ADDS (3)
+
+struct bc_select_state {
+    int32_t start;
+    int64_t net;
+    int8_t  varies;
+};
+
+struct bc_cell_delta {
+    int32_t offset;
+    int32_t delta;
+};
+
+static int8_t
+bc_opcode_is_foldable(uint8_t op)
+{
+    return op == BC_ADD
+            || op == BC_MOVE
+            || op == BC_SELECT;
+}
+
+// func_pos starts at 0 in every function and only v and ^ change it, so it
+// is known statically up to the first loop whose body moves it. Calls made
+// while it is known and points to a function become direct calls, one out
+// of range is left to fail at run time. Once no call reads func_pos, the
+// selects are dropped.
+static int8_t
+bc_func_resolve_calls(struct bc_func *func, int32_t funcs_num)
+{
+    struct bc_select_state *stack = calloc(func->code_len + 1, sizeof(*stack));
+    int8_t *varies = calloc(func->code_len + 1, sizeof(*varies));
+    if (!stack || !varies) {
+        free(stack);
+        free(varies);
+        return -1;
+    }
+    int32_t stack_len = 1;
+
+    // A loop varies func_pos if its body moves it or holds such a loop.
+    for (int32_t pc = 0; pc < func->code_len; pc++) {
+        const struct bc_instr *instr = &func->code[pc];
+        struct bc_select_state *top = &stack[stack_len - 1];
+
+        if (instr->op == BC_SELECT) {
+            top->net += instr->arg;
+        } else if (instr->op == BC_JZ) {
+            struct bc_select_state *loop = &stack[stack_len++];
+            loop->start = pc;
+            loop->net = 0;
+            loop->varies = 0;
+        } else if (instr->op == BC_JNZ) {
+            if (stack_len < 2) {
+                free(stack);
+                free(varies);
+                return -1;
+            }
+
+            varies[top->start] = top->varies || top->net != 0;
+            stack_len--;
+            if (varies[top->start]) {
+                stack[stack_len - 1].varies = 1;
+            }
+        }
+    }
+
+    free(stack);
+
+    int8_t known = 1;
+    int8_t dynamic = 0;
+    uint32_t func_pos = 0;
+
+    for (int32_t pc = 0; pc < func->code_len; pc++) {
+        struct bc_instr *instr = &func->code[pc];
+
+        if (instr->op == BC_SELECT) {
+            func_pos += instr->arg;
+        } else if (instr->op == BC_JZ && varies[pc]) {
+            known = 0;
+        } else if (instr->op == BC_CALL) {
+            if (known && func_pos < (uint32_t) funcs_num) {
+                instr->op = BC_CALL_DIRECT;
+                instr->arg = func_pos;
+            } else {
+                dynamic = 1;
+            }
+        }
+    }
+
+    free(varies);
+
+    if (dynamic) {
+        return 0;
+    }
+
+    int32_t len = 0;
+    for (int32_t pc = 0; pc < func->code_len; pc++) {
+        if (func->code[pc].op != BC_SELECT) {
+            func->code[len++] = func->code[pc];
+        }
+    }
+    func->code_len = len;
+
+    return bc_func_relink(func);
+}
+
+// Merges runs of +, -, <, >, v and ^ into a single counted instruction,
+// runs that cancel out (like +- or <>) are dropped entirely.
+static int8_t
+bc_func_fold_runs(struct bc_func *func)
+{
+    struct bc_instr *code = func->code;
+    int32_t len = 0;
+
+    for (int32_t pc = 0; pc < func->code_len; pc++) {
+        struct bc_instr instr = code[pc];
+
+        if (bc_opcode_is_foldable(instr.op)
+                && len > 0
+                && code[len - 1].op == instr.op) {
+            code[len - 1].arg += instr.arg;
+            if (code[len - 1].arg == 0) {
+                len--;
+            }
+            continue;
+        }
+
+        code[len++] = instr;
+    }
+
+    func->code_len = len;
+
+    return bc_func_relink(func);
+}
+
+// Collects the per-cell deltas of a loop body that consists only of add and
+// move instructions and returns the number of touched cells. Returns -1 if
+// the body does anything else or its net pointer movement is not zero.
+static int32_t
+bc_loop_collect_deltas(
+        const struct bc_instr *body,
+        int32_t                body_len,
+        struct bc_cell_delta  *deltas)
+{
+    int32_t deltas_num = 0;
+    int32_t pos = 0;
+
+    for (int32_t i = 0; i < body_len; i++) {
+        const struct bc_instr *instr = &body[i];
+
+        if (instr->op == BC_MOVE) {
+            pos += instr->arg;
+            continue;
+        }
+        if (instr->op != BC_ADD) {
+            return -1;
+        }
+
+        int32_t j = 0;
+        while (j < deltas_num && deltas[j].offset != pos) {
+            j++;
+        }
+        if (j == deltas_num) {
+            if (deltas_num == BC_LOOP_MAX_CELLS) {
+                return -1;
+            }
+            deltas[j].offset = pos;
+            deltas[j].delta = 0;
+            deltas_num++;
+        }
+        deltas[j].delta += instr->arg;
+    }
+
+    if (pos != 0) {
+        return -1;
+    }
+
+    return deltas_num;
+}
+
+static int32_t
+bc_deltas_find(struct bc_cell_delta *deltas, int32_t deltas_num, int32_t offset)
+{
+    for (int32_t i = 0; i < deltas_num; i++) {
+        if (deltas[i].offset == offset) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Replaces balanced loops, like [-], [->+<] or [->+++>++<<], with
+// multiply-accumulate instructions followed by a set-zero of the loop cell,
+// a body that runs at most once.
+static int8_t
+bc_func_replace_balanced_loops(struct bc_func *func)
+{
+    struct bc_instr *code = func->code;
+    struct bc_cell_delta deltas[BC_LOOP_MAX_CELLS];
+    int32_t len = 0;
+
+    for (int32_t pc = 0; pc < func->code_len; pc++) {
+        struct bc_instr instr = code[pc];
+
+        if (instr.op != BC_JZ) {
+            code[len++] = instr;
+            continue;
+        }
+
+        int32_t end = instr.arg - 1;
+        int32_t deltas_num = bc_loop_collect_deltas(
+                &code[pc + 1], end - pc - 1, deltas);
+        int32_t self = deltas_num < 0
+                ? -1
+                : bc_deltas_find(deltas, deltas_num, 0);
+
+        // [+] terminates by wrapping around, so it is still a clear loop.
+        int8_t is_clear = deltas_num == 1 && self == 0
+                && (deltas[0].delta == 1 || deltas[0].delta == -1);
+        int8_t is_mul = self >= 0 && deltas[self].delta == -1;
+
+        if (!is_clear && !is_mul) {
+            code[len++] = instr;
+            continue;
+        }
+
+        // The loop is kept around the multiplications, so that they only
+        // touch the other cells if the loop would run.
+        int32_t start = len;
+        code[len++] = instr;
+
+        for (int32_t i = 0; i < deltas_num; i++) {
+            if (i == self || deltas[i].delta == 0) {
+                continue;
+            }
+
+            struct bc_instr *mul = &code[len++];
+            mul->op = BC_MUL;
+            mul->arg = deltas[i].delta;
+            mul->offset = deltas[i].offset;
+        }
+
+        int8_t has_muls = len > start + 1;
+        if (!has_muls) {
+            len = start;
+        }
+
+        struct bc_instr *set = &code[len++];
+        set->op = BC_SET;
+        set->arg = 0;
+        set->offset = 0;
+
+        if (has_muls) {
+            code[len++] = code[end];
+        }
+
+        pc = end;
+    }
+
+    func->code_len = len;
+
+    return bc_func_relink(func);
+}
+
+// Replaces loops that only move the head, like [>] or [<<], with a scan for
+// the nearest zero cell.
+static int8_t
+bc_func_replace_scan_loops(struct bc_func *func)
+{
+    struct bc_instr *code = func->code;
+    int32_t len = 0;
+
+    for (int32_t pc = 0; pc < func->code_len; pc++) {
+        struct bc_instr instr = code[pc];
+
+        if (instr.op == BC_JZ
+                && instr.arg == pc + 3
+                && code[pc + 1].op == BC_MOVE) {
+            struct bc_instr *scan = &code[len++];
+            scan->op = BC_SCAN;
+            scan->arg = code[pc + 1].arg;
+            scan->offset = 0;
+
+            pc += 2;
+            continue;
+        }
+
+        code[len++] = instr;
+    }
+
+    func->code_len = len;
+
+    return bc_func_relink(func);
+}
+
+// Instructions that can reach a cell away from the head through offset.
+static int8_t
+bc_opcode_has_offset(uint8_t op)
+{
+    return op == BC_ADD
+            || op == BC_SET
+            || op == BC_INPUT
+            || op == BC_OUTPUT;
+}
+
+// Defers head movement to the end of a straight-line run, e.g. >++>+++<<-
+// becomes three adds at offsets 1, 2 and 0 without a move. The moves are
+// applied before anything that works on the head itself: jumps, scans,
+// multiplications, calls and returns. Jump targets always follow a jump, so
+// no move is pending there.
+static int8_t
+bc_func_defer_moves(struct bc_func *func)
+{
+    struct bc_instr *code = func->code;
+    int32_t len = 0;
+    int64_t pending = 0;
+
+    for (int32_t pc = 0; pc < func->code_len; pc++) {
+        struct bc_instr instr = code[pc];
+
+        if (instr.op == BC_MOVE
+                && pending + instr.arg >= INT32_MIN
+                && pending + instr.arg <= INT32_MAX) {
+            pending += instr.arg;
+            continue;
+        }
+
+        if (bc_opcode_has_offset(instr.op)
+                && pending + instr.offset >= INT32_MIN
+                && pending + instr.offset <= INT32_MAX) {
+            instr.offset += pending;
+
+            if (instr.op == BC_ADD
+                    && len > 0
+                    && code[len - 1].op == BC_ADD
+                    && code[len - 1].offset == instr.offset) {
+                code[len - 1].arg += instr.arg;
+                if (code[len - 1].arg == 0) {
+                    len--;
+                }
+                continue;
+            }
+
+            code[len++] = instr;
+            continue;
+        }
+
+        if (pending != 0 && instr.op != BC_SELECT) {
+            struct bc_instr *move = &code[len++];
+            move->op = BC_MOVE;
+            move->arg = pending;
+            move->offset = 0;
+            pending = 0;
+        }
+
+        code[len++] = instr;
+    }
+
+    if (pending != 0) {
+        struct bc_instr *move = &code[len++];
+        move->op = BC_MOVE;
+        move->arg = pending;
+        move->offset = 0;
+    }
+
+    func->code_len = len;
+
+    return bc_func_relink(func);
+}
+
+static int
+bc_cell_delta_compare(const void *a_, const void *b_)
+{
+    const struct bc_cell_delta *a = a_;
+    const struct bc_cell_delta *b = b_;
+
+    return (a->offset > b->offset) - (a->offset < b->offset);
+}
+
+// Sorts the deltas by offset and merges the ones of the same cell, returns
+// the new number of deltas.
+static int32_t
+bc_deltas_merge(struct bc_cell_delta *deltas, int32_t deltas_num)
+{
+    qsort(deltas, deltas_num, sizeof(*deltas), bc_cell_delta_compare);
+
+    int32_t len = 0;
+    for (int32_t i = 0; i < deltas_num; i++) {
+        if (len > 0 && deltas[len - 1].offset == deltas[i].offset) {
+            deltas[len - 1].delta = (uint32_t) deltas[len - 1].delta + deltas[i].delta;
+        } else {
+            deltas[len++] = deltas[i];
+        }
+    }
+
+    return len;
+}
+
+static void
+bc_vec_build(
+        struct bc_vec              *vec,
+        const struct bc_cell_delta *deltas,
+        int32_t                     deltas_num,
+        int32_t                     bytes,
+        uint8_t                     cell_size)
+{
+    memset(vec, 0, sizeof(*vec));
+    vec->cells = bytes / cell_size;
+    vec->bytes = bytes;
+
+    for (int32_t i = 0; i < deltas_num; i++) {
+        int32_t pos = (deltas[i].offset - deltas[0].offset) * cell_size;
+
+        for (int32_t j = 0; j < cell_size; j++) {
+            vec->deltas[pos + j] = (uint32_t) deltas[i].delta >> (8 * j);
+        }
+    }
+}
+
+// Packs runs of adds to nearby cells, like >+++++++>++++++++++>+++>+ once
+// its moves are deferred, into vector adds of 4 to BC_VEC_MAX_BYTES bytes.
+// A vector starts at an add and ends before the last add it could reach,
+// so it never touches a cell the adds would not. The vectors of a run do
+// not overlap: a load that partly overlaps a store just before it stalls.
+static int8_t
+bc_func_vectorize_adds(struct bc_func *func, struct bc_program *program)
+{
+    struct bc_instr *code = func->code;
+    int32_t cell_size = program->cell_size;
+    int32_t cells_max = BC_VEC_MAX_BYTES / cell_size;
+
+    struct bc_cell_delta *deltas = calloc(func->code_len + 1, sizeof(*deltas));
+    if (!deltas) {
+        return -1;
+    }
+
+    int32_t len = 0;
+    for (int32_t pc = 0; pc < func->code_len;) {
+        if (code[pc].op != BC_ADD) {
+            code[len++] = code[pc++];
+            continue;
+        }
+
+        int32_t deltas_num = 0;
+        for (; pc < func->code_len && code[pc].op == BC_ADD; pc++) {
+            deltas[deltas_num].offset = code[pc].offset;
+            deltas[deltas_num].delta = code[pc].arg;
+            deltas_num++;
+        }
+        if (deltas_num >= BC_VEC_MIN_ADDS) {
+            deltas_num = bc_deltas_merge(deltas, deltas_num);
+        }
+
+        for (int32_t i = 0; i < deltas_num;) {
+            int32_t last = i;
+            while (last + 1 < deltas_num
+                    && (int64_t) deltas[last + 1].offset - deltas[i].offset < cells_max) {
+                last++;
+            }
+
+            int32_t span = (deltas[last].offset - deltas[i].offset + 1) * cell_size;
+            int32_t bytes = 4;
+            while (bytes * 2 <= span) {
+                bytes *= 2;
+            }
+            while (last > i && (deltas[last].offset - deltas[i].offset + 1) * cell_size > bytes) {
+                last--;
+            }
+
+            if (last - i + 1 < BC_VEC_MIN_ADDS || span < 4) {
+                struct bc_instr *add = &code[len++];
+                add->op = BC_ADD;
+                add->arg = deltas[i].delta;
+                add->offset = deltas[i].offset;
+                i++;
+                continue;
+            }
+
+            struct bc_vec vec;
+            bc_vec_build(&vec, &deltas[i], last - i + 1, bytes, cell_size);
+
+            int32_t index = bc_program_add_vec(program, &vec);
+            if (index < 0) {
+                free(deltas);
+                return -1;
+            }
+
+            struct bc_instr *add = &code[len++];
+            add->op = BC_ADD_VEC;
+            add->arg = index;
+            add->offset = deltas[i].offset;
+            i = last + 1;
+        }
+    }
+
+    free(deltas);
+    func->code_len = len;
+
+    return bc_func_relink(func);
+}
+
+// Direct calls of functions that return the same code every time, see
+// bytecode/include/eval.h, become stores of that code. Such a call is
+// never seen from the outside, it only takes a frame for a while.
+static void
+bc_program_fold_calls(struct bc_program *program, struct bc_eval *eval)
+{
+    for (int32_t i = 0; i < program->funcs_num; i++) {
+        struct bc_func *func = &program->funcs[i];
+
+        for (int32_t pc = 0; pc < func->code_len; pc++) {
+            struct bc_instr *instr = &func->code[pc];
+            uint32_t return_code = 0;
+
+            if (instr->op != BC_CALL_DIRECT || bc_eval_call(eval, instr->arg, &return_code)) {
+                continue;
+            }
+
+            instr->op = BC_SET;
+            instr->arg = (int32_t) return_code;
+            instr->offset = 0;
+        }
+    }
+}
+
+static void
+bc_instr_init(struct bc_instr *instr, uint8_t op, int32_t arg, int32_t offset)
+{
+    instr->op = op;
+    instr->arg = arg;
+    instr->offset = offset;
+}
+
+// Main starts with the output and the frame its prefix left, see
+// bc_eval_prefix(), and goes on with the rest of its code. The output goes
+// through the cell under the head, the tape is rebuilt with adds to zeroed
+// cells that are packed into vectors.
+static int8_t
+bc_program_precompute_prefix(struct bc_program *program, struct bc_eval *eval)
+{
+    struct bc_func *func = &program->funcs[0];
+    struct bc_eval_frame frame;
+
+    int8_t err = bc_eval_prefix(eval, &frame);
+    if (err) {
+        return 0;
+    }
+    if (frame.pc == 0 || frame.head < INT32_MIN || frame.head > INT32_MAX) {
+        bc_eval_frame_free(&frame);
+        return 0;
+    }
+
+    int32_t cells = eval->tape_size;
+    while (cells > 0 && frame.tape[cells - 1] == 0) {
+        cells--;
+    }
+
+    int32_t len = 2 * frame.output_len + cells + 3 + func->code_len - frame.pc;
+    struct bc_instr *code = calloc(len, sizeof(*code));
+    if (!code) {
+        bc_eval_frame_free(&frame);
+        return -1;
+    }
+
+    int32_t new_len = 0;
+    for (int32_t i = 0; i < frame.output_len; i++) {
+        if (i == 0 || frame.output[i] != frame.output[i - 1]) {
+            bc_instr_init(&code[new_len++], BC_SET, frame.output[i], 0);
+        }
+        bc_instr_init(&code[new_len++], BC_OUTPUT, 0, 0);
+    }
+
+    // Cell 0 still holds the last byte of the output, even if it ends up
+    // zeroed.
+    int32_t first = 0;
+    if (frame.output_len > 0) {
+        bc_instr_init(&code[new_len++], BC_SET, (int32_t) frame.tape[0], 0);
+        first = 1;
+    }
+    for (int32_t i = first; i < cells; i++) {
+        if (frame.tape[i] != 0) {
+            bc_instr_init(&code[new_len++], BC_ADD, (int32_t) frame.tape[i], i);
+        }
+    }
+
+    if (frame.head != 0) {
+        bc_instr_init(&code[new_len++], BC_MOVE, (int32_t) frame.head, 0);
+    }
+    if (frame.func_pos != 0) {
+        bc_instr_init(&code[new_len++], BC_SELECT, (int32_t) frame.func_pos, 0);
+    }
+
+    memcpy(&code[new_len], &func->code[frame.pc], (func->code_len - frame.pc) * sizeof(*code));
+    new_len += func->code_len - frame.pc;
+
+    bc_eval_frame_free(&frame);
+
+    free(func->code);
+    func->code = code;
+    func->code_len = new_len;
+    func->code_max_len = len;
+
+    err = bc_func_relink(func);
+    if (err) {
+        return -1;
+    }
+
+    return bc_func_vectorize_adds(func, program);
+}
+
+// A call right before a return hands its return code straight to the
+// caller, so the callee can take over the frame. The return is kept, it may
+// still be a jump target.
+static void
+bc_func_replace_tail_calls(struct bc_func *func)
+{
+    for (int32_t pc = 0; pc + 1 < func->code_len; pc++) {
+        struct bc_instr *instr = &func->code[pc];
+        if (func->code[pc + 1].op != BC_RETURN) {
+            continue;
+        }
+
+        if (instr->op == BC_CALL) {
+            instr->op = BC_TAIL_CALL;
+        } else if (instr->op == BC_CALL_DIRECT) {
+            instr->op = BC_TAIL_CALL_DIRECT;
+        }
+    }
+}
+
+int8_t
+bc_program_optimize(struct bc_program *program, uint32_t tape_size)
+{
+    if (!program) {
+        return -1;
+    }
+
+    for (int32_t i = 0; i < program->funcs_num; i++) {
+        struct bc_func *func = &program->funcs[i];
+
+        int8_t err = bc_func_resolve_calls(func, program->funcs_num);
+        if (err) {
+            return -1;
+        }
+
+        err = bc_func_fold_runs(func);
+        if (err) {
+            return -1;
+        }
+
+        err = bc_func_replace_balanced_loops(func);
+        if (err) {
+            return -1;
+        }
+
+        err = bc_func_replace_scan_loops(func);
+        if (err) {
+            return -1;
+        }
+
+        err = bc_func_defer_moves(func);
+        if (err) {
+            return -1;
+        }
+
+        err = bc_func_vectorize_adds(func, program);
+        if (err) {
+            return -1;
+        }
+    }
+
+    struct bc_eval eval;
+    int8_t err = bc_eval_init(&eval, program, tape_size);
+    if (err) {
+        return -1;
+    }
+
+    bc_program_fold_calls(program, &eval);
+    if (program->funcs_num > 0) {
+        err = bc_program_precompute_prefix(program, &eval);
+    }
+    bc_eval_free(&eval);
+    if (err) {
+        return -1;
+    }
+
+    for (int32_t i = 0; i < program->funcs_num; i++) {
+        bc_func_replace_tail_calls(&program->funcs[i]);
+    }
+
+    return 0;
+}
\ No newline at end of file
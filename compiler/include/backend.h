@@ -5,11 +5,24 @@
 #ifndef BACKEND_H
 #define BACKEND_H
 
+#include "bytecode.h"
+
 #include <stdint.h>
 
 typedef int8_t (*backend_open_file)(void *back_, const char *filename);
 typedef int8_t (*backend_close_file)(void *back_);
-typedef int8_t (*backend_prepare)(void *back_);
+typedef int8_t (*backend_prepare)(void *back_, struct bc_program *program);
 typedef int8_t (*backend_write_)(void *back_);
+typedef void   (*backend_free)(void *back_);
+
+struct backend_ops {
+    const char         *name;
+    uint64_t            back_size;
+    backend_open_file   open_file;
+    backend_close_file  close_file;
+    backend_prepare     prepare;
+    backend_write_      write_;
+    backend_free        free;
+};
 
 #endif // BACKEND_H
\ No newline at end of file
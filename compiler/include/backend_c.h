@@ -0,0 +1,33 @@
+/*
+ * Zherdev, 2021
+ */
+
+#ifndef BACKEND_C_H
+#define BACKEND_C_H
+
+#include "bytecode.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct backend_c {
+    FILE              *file;
+    struct bc_program *program;
+};
+
+int8_t
+backend_c_open_file(void *back_, const char *filename);
+
+int8_t
+backend_c_close_file(void *back_);
+
+int8_t
+backend_c_prepare(void *back_, struct bc_program *program);
+
+int8_t
+backend_c_write_(void *back_);
+
+void
+backend_c_free(void *back_);
+
+#endif // BACKEND_C_H
\ No newline at end of file
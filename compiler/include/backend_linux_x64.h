@@ -0,0 +1,43 @@
+/*
+ * Zherdev, 2021
+ */
+
+#ifndef BACKEND_LINUX_X64_H
+#define BACKEND_LINUX_X64_H
+
+#include "bytecode.h"
+#include "codegen_x64.h"
+
+#include <stdint.h>
+#include <elf.h>
+
+#define BACKEND_LINUX_X64_BASE_ADDR (0x400000)
+
+struct backend_linux_x64 {
+    int32_t fd;
+
+    Elf64_Ehdr header;
+    Elf64_Phdr ph_text;
+    Elf64_Phdr ph_stack;
+
+    uint64_t text_offset;
+
+    struct codegen_x64 gen;
+};
+
+int8_t
+backend_linux_x64_open_file(void *back_, const char *filename);
+
+int8_t
+backend_linux_x64_close_file(void *back_);
+
+int8_t
+backend_linux_x64_prepare(void *back_, struct bc_program *program);
+
+int8_t
+backend_linux_x64_write_(void *back_);
+
+void
+backend_linux_x64_free(void *back_);
+
+#endif // BACKEND_LINUX_X64_H
\ No newline at end of file
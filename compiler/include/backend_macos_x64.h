@@ -5,6 +5,8 @@
 #ifndef BACKEND_MACOS_X64_H
 #define BACKEND_MACOS_X64_H
 
+#include "bytecode.h"
+
 #include <stdint.h>
 #include <mach-o/loader.h>
 #include <mach-o/nlist.h>
@@ -32,7 +34,7 @@ int8_t
 backend_macos_x64_close_file(void *back_);
 
 int8_t
-backend_macos_x64_prepare(void *back_);
+backend_macos_x64_prepare(void *back_, struct bc_program *program);
 
 int8_t
 backend_macos_x64_write_(void *back_);
@@ -0,0 +1,113 @@
+/*
+ * Zherdev, 2021
+ */
+
+#ifndef CODEGEN_X64_H
+#define CODEGEN_X64_H
+
+#include "bytecode.h"
+
+#include <stdint.h>
+
+// Cells of a tape in a standalone executable.
+#define CODEGEN_X64_TAPE_SIZE (10240)
+// Bytes of output a standalone executable collects before writing them.
+#define CODEGEN_X64_OUTPUT_SIZE (65536)
+
+// Native stack used by a Brainfunction in the JIT: four saved registers, the
+// padding and the return address. Its tape is a frame of the runtime.
+#define CODEGEN_X64_FRAME_SIZE (48)
+
+enum codegen_x64_target {
+    // Position independent code for the in-process JIT, I/O, scans and
+    // frames are calls into the runtime helpers.
+    CODEGEN_X64_TARGET_JIT,
+
+    // Code for a standalone executable, I/O and '%' go through raw Linux
+    // syscalls. The output is buffered on the stack of _start.
+    CODEGEN_X64_TARGET_STANDALONE
+};
+
+// Passed to the JIT entry, the generated code relies on the layout of the
+// first five fields. The Brainfunctions run on a separate stack that
+// starts at stack_top, a call that finds rsp below stack_limit fails.
+struct codegen_x64_ctx {
+    uint64_t  saved_rsp;
+    uint64_t  stack_top;
+    uint64_t  stack_limit;
+    uint64_t  tape_bytes;
+    uint64_t  out_of_bounds; // set when the code fails on a tape access
+    void     *data;
+};
+
+struct codegen_x64_helpers {
+    int32_t (*input)(struct codegen_x64_ctx *ctx);
+    int32_t (*output)(struct codegen_x64_ctx *ctx, uint8_t cell);
+    int32_t (*sys_call)(struct codegen_x64_ctx *ctx, void *cell, void *end);
+    void *(*scan_right)(void *pos, void *end, int32_t stride);
+    void *(*scan_left)(void *pos, void *begin, int32_t stride);
+
+    // Returns the tape of a new frame for function index, NULL on error.
+    void *(*push)(struct codegen_x64_ctx *ctx, int32_t index);
+    // Drops the top frame, its head got no further right than head_max.
+    void (*pop)(struct codegen_x64_ctx *ctx, void *head_max);
+};
+
+struct codegen_x64_fixup {
+    int32_t pos;
+    int32_t target;
+};
+
+struct codegen_x64 {
+    enum codegen_x64_target           target;
+    const struct codegen_x64_helpers *helpers;
+    uint8_t                           cell_size;
+    int32_t                           tape_bytes;
+    int8_t                            avx2;
+    const struct bc_vec              *vecs;
+
+    uint8_t *code;
+    int32_t  code_len;
+    int32_t  code_max_len;
+    int8_t   err;
+
+    int32_t  entry_offset;
+    int32_t  error_offset;
+    int32_t  bounds_error_offset;
+    int32_t  sys_call_offset;
+    int32_t  flush_offset;
+    int32_t  table_offset;
+    int32_t *func_offsets;
+    int32_t  funcs_num;
+
+    int32_t *pc_offsets;
+    int8_t   head_tracked; // moves right update r15
+    struct codegen_x64_fixup *fixups;
+    int32_t  fixups_num;
+    int32_t  fixups_max_num;
+    int32_t *table_fixups;
+    int32_t  table_fixups_num;
+    int32_t  table_fixups_max_num;
+    struct codegen_x64_fixup *func_fixups;
+    int32_t  func_fixups_num;
+    int32_t  func_fixups_max_num;
+};
+
+// The JIT entry has the int64_t (*)(struct codegen_x64_ctx *, int32_t index)
+// signature, it returns the return code of the function or -1 on error.
+// The code is specialized for the cell width of the compiled program, the
+// helpers must be the ones for that width.
+// The standalone entry is the _start of an executable and never returns.
+int8_t
+codegen_x64_init(
+        struct codegen_x64               *gen,
+        enum codegen_x64_target           target,
+        const struct codegen_x64_helpers *helpers);
+
+void
+codegen_x64_free(struct codegen_x64 *gen);
+
+int8_t
+codegen_x64_compile(struct codegen_x64 *gen, struct bc_program *program);
+
+#endif // CODEGEN_X64_H
\ No newline at end of file
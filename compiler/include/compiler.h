@@ -6,24 +6,42 @@
 #define COMPILER_H
 
 #include "parser.h"
+#include "bytecode.h"
+#include "backend.h"
 
 #include <stdint.h>
 
-struct complier {
-    struct parser    parser;
-    struct sem_node *sem_root;
+enum compiler_backend {
+    COMPILER_BACKEND_LINUX_X64,
+    COMPILER_BACKEND_C,
+
+    COMPILER_BACKENDS_NUM
+};
+
+struct compiler {
+    struct parser          parser;
+    struct bc_program      program;
+    enum compiler_backend  backend;
+    uint8_t                cell_size;
 };
 
 int8_t
-compiler_init(struct compiler *compiler, const char *filename);
+compiler_backend_from_str(const char *name, enum compiler_backend *backend);
+
+int8_t
+compiler_init(
+        struct compiler       *compiler,
+        const char            *filename,
+        enum compiler_backend  backend,
+        uint8_t                cell_size);
 
 int8_t
 compiler_free(struct compiler *compiler);
 
 int8_t
-compiler_read(struct interpreter *compiler);
+compiler_read(struct compiler *compiler);
 
 int8_t
-compiler_compile(struct interpreter *compiler);
+compiler_compile(struct compiler *compiler, const char *filename);
 
 #endif // COMPILER_H
\ No newline at end of file
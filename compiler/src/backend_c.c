@@ -0,0 +1,391 @@
+/*
+ * See compiler/include/backend_c.h for details.
+ *
+ * Every Brainfunction becomes a C function with its tape in a local array,
+ * loops become while loops. The output is meant to be built with the
+ * system C compiler, e.g. cc -O3 out.c.
+ *
+ * Zherdev, 2021
+ */
+
+#include "backend_c.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#define BACKEND_C_TAPE_SIZE (10240)
+#define BACKEND_C_ERROR_EXIT_CODE (253)
+
+int8_t
+backend_c_open_file(void *back_, const char *filename)
+{
+    struct backend_c *back = back_;
+    if (!back || !filename) {
+        return -1;
+    }
+
+    back->file = fopen(filename, "w");
+    if (!back->file) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int8_t
+backend_c_close_file(void *back_)
+{
+    struct backend_c *back = back_;
+    if (!back || !back->file) {
+        return -1;
+    }
+
+    int8_t err = fclose(back->file);
+    back->file = NULL;
+    if (err) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int8_t
+backend_c_prepare(void *back_, struct bc_program *program)
+{
+    struct backend_c *back = back_;
+    if (!back || !program) {
+        return -1;
+    }
+
+    back->program = program;
+
+    return 0;
+}
+
+static void
+backend_c_line(struct backend_c *back, int32_t depth, const char *fmt, ...)
+{
+    for (int32_t i = 0; i < depth; i++) {
+        fputs("    ", back->file);
+    }
+
+    va_list va;
+    va_start(va, fmt);
+    vfprintf(back->file, fmt, va);
+    va_end(va);
+
+    fputc('\n', back->file);
+}
+
+// The Systemf '%', see interpreter/include/sys_call.h for the layout of the
+// argument block.
+static void
+backend_c_write_sys_call(struct backend_c *back)
+{
+    backend_c_line(back, 0, "static inline void");
+    backend_c_line(back, 0, "bf_sys_call(cell *p, cell *end)");
+    backend_c_line(back, 0, "{");
+    backend_c_line(back, 1, "long args[6] = {0};");
+    backend_c_line(back, 1, "cell *pos = &p[2];");
+    backend_c_line(back, 0, "");
+    backend_c_line(back, 1, "if (end - p < 2 || p[1] > 6) {");
+    backend_c_line(back, 2, "bf_error();");
+    backend_c_line(back, 1, "}");
+    backend_c_line(back, 1, "for (int i = 0; i < p[1]; i++) {");
+    backend_c_line(back, 2, "if (end - pos < 2 || end - pos - 2 < pos[1]) {");
+    backend_c_line(back, 3, "bf_error();");
+    backend_c_line(back, 2, "}");
+    backend_c_line(back, 2, "cell type = pos[0];");
+    backend_c_line(back, 2, "cell len = pos[1];");
+    backend_c_line(back, 2, "pos += 2;");
+    backend_c_line(back, 2, "if (type == 0) {");
+    backend_c_line(back, 3, "unsigned long value = 0;");
+    backend_c_line(back, 3, "for (int j = 0; j < len; j++) {");
+    backend_c_line(back, 4, "value = value << (8 * sizeof(cell)) | pos[j];");
+    backend_c_line(back, 3, "}");
+    backend_c_line(back, 3, "args[i] = value;");
+    backend_c_line(back, 2, "} else if (type == 1) {");
+    backend_c_line(back, 3, "args[i] = (long) pos;");
+    backend_c_line(back, 2, "} else {");
+    backend_c_line(back, 3, "bf_error();");
+    backend_c_line(back, 2, "}");
+    backend_c_line(back, 2, "pos += len;");
+    backend_c_line(back, 1, "}");
+    backend_c_line(back, 0, "");
+    backend_c_line(back, 1, "fflush(stdout);");
+    backend_c_line(back, 1, "long res = syscall(p[0], args[0], args[1], args[2], args[3], args[4], args[5]);");
+    backend_c_line(back, 1, "p[0] = res == -1 ? -errno : res;");
+    backend_c_line(back, 0, "}");
+    backend_c_line(back, 0, "");
+}
+
+static void
+backend_c_write_prelude(struct backend_c *back)
+{
+    int32_t funcs_num = back->program->funcs_num;
+
+    backend_c_line(back, 0, "/*");
+    backend_c_line(back, 0, " * Generated by the sysfun-bf compiler.");
+    backend_c_line(back, 0, " */");
+    backend_c_line(back, 0, "");
+    backend_c_line(back, 0, "#define _GNU_SOURCE");
+    backend_c_line(back, 0, "");
+    backend_c_line(back, 0, "#include <errno.h>");
+    backend_c_line(back, 0, "#include <stdint.h>");
+    backend_c_line(back, 0, "#include <stdio.h>");
+    backend_c_line(back, 0, "#include <stdlib.h>");
+    backend_c_line(back, 0, "#include <string.h>");
+    backend_c_line(back, 0, "#include <unistd.h>");
+    backend_c_line(back, 0, "");
+    backend_c_line(back, 0, "typedef uint%d_t cell;", back->program->cell_size * 8);
+    backend_c_line(back, 0, "");
+    backend_c_line(back, 0, "#define TAPE_SIZE (%d)", BACKEND_C_TAPE_SIZE);
+    backend_c_line(back, 0, "#define FUNCS_NUM (%d)", funcs_num);
+    backend_c_line(back, 0, "");
+
+    for (int32_t i = 0; i < funcs_num; i++) {
+        backend_c_line(back, 0, "static cell bf_func_%d(void);", i);
+    }
+    backend_c_line(back, 0, "");
+
+    backend_c_line(back, 0, "static cell (*const bf_funcs[FUNCS_NUM])(void) = {");
+    for (int32_t i = 0; i < funcs_num; i++) {
+        backend_c_line(back, 1, "bf_func_%d,", i);
+    }
+    backend_c_line(back, 0, "};");
+    backend_c_line(back, 0, "");
+
+    backend_c_line(back, 0, "static inline void");
+    backend_c_line(back, 0, "bf_error(void)");
+    backend_c_line(back, 0, "{");
+    backend_c_line(back, 1, "exit(%d);", BACKEND_C_ERROR_EXIT_CODE);
+    backend_c_line(back, 0, "}");
+    backend_c_line(back, 0, "");
+
+    backend_c_write_sys_call(back);
+
+    backend_c_line(back, 0, "static inline cell");
+    backend_c_line(back, 0, "bf_call(uint32_t func_pos)");
+    backend_c_line(back, 0, "{");
+    backend_c_line(back, 1, "if (func_pos >= FUNCS_NUM) {");
+    backend_c_line(back, 2, "bf_error();");
+    backend_c_line(back, 1, "}");
+    backend_c_line(back, 1, "return bf_funcs[func_pos]();");
+    backend_c_line(back, 0, "}");
+    backend_c_line(back, 0, "");
+}
+
+static void
+backend_c_write_scan(struct backend_c *back, int32_t depth, int32_t stride)
+{
+    // memchr() only finds zero bytes.
+    if (stride == 1 && back->program->cell_size == 1) {
+        backend_c_line(back, depth, "p = memchr(p, 0, &tape[TAPE_SIZE] - p);");
+        backend_c_line(back, depth, "if (!p) {");
+        backend_c_line(back, depth + 1, "bf_error();");
+        backend_c_line(back, depth, "}");
+        return;
+    }
+
+    backend_c_line(back, depth, "while (p[0]) {");
+    backend_c_line(back, depth + 1, "p += %d;", stride);
+    backend_c_line(back, depth, "}");
+}
+
+// The deltas go into a constant array, so that the C compiler can turn the
+// loop back into a vector add.
+static void
+backend_c_write_add_vec(struct backend_c *back, int32_t depth, int32_t offset, const struct bc_vec *vec)
+{
+    int32_t cell_size = back->program->cell_size;
+    char deltas[BC_VEC_MAX_BYTES * 12] = {0};
+    int32_t len = 0;
+
+    for (int32_t i = 0; i < vec->cells; i++) {
+        uint32_t delta = 0;
+        for (int32_t j = 0; j < cell_size; j++) {
+            delta |= (uint32_t) vec->deltas[i * cell_size + j] << (8 * j);
+        }
+
+        len += snprintf(&deltas[len], sizeof(deltas) - len, i == 0 ? "%u" : ", %u", delta);
+    }
+
+    backend_c_line(back, depth, "{");
+    backend_c_line(back, depth + 1, "static const cell deltas[%d] = {%s};", vec->cells, deltas);
+    backend_c_line(back, depth + 1, "for (int i = 0; i < %d; i++) {", vec->cells);
+    backend_c_line(back, depth + 2, "p[%d + i] += deltas[i];", offset);
+    backend_c_line(back, depth + 1, "}");
+    backend_c_line(back, depth, "}");
+}
+
+static int8_t
+backend_c_write_instr(struct backend_c *back, int32_t depth, const struct bc_instr *instr)
+{
+    switch (instr->op) {
+        case BC_ADD:
+            if (instr->arg < 0) {
+                backend_c_line(back, depth, "p[%d] -= %d;", instr->offset, -instr->arg);
+            } else {
+                backend_c_line(back, depth, "p[%d] += %d;", instr->offset, instr->arg);
+            }
+            break;
+
+        case BC_MOVE:
+            backend_c_line(back, depth, "p += %d;", instr->arg);
+            break;
+
+        case BC_SELECT:
+            backend_c_line(back, depth, "func_pos += %d;", instr->arg);
+            break;
+
+        case BC_JZ:
+            backend_c_line(back, depth, "while (p[0]) {");
+            break;
+
+        case BC_JNZ:
+            backend_c_line(back, depth, "}");
+            break;
+
+        case BC_INPUT:
+            backend_c_line(back, depth, "p[%d] = getchar();", instr->offset);
+            break;
+
+        case BC_OUTPUT:
+            backend_c_line(back, depth, "if (putchar(p[%d]) == EOF) {", instr->offset);
+            backend_c_line(back, depth + 1, "bf_error();");
+            backend_c_line(back, depth, "}");
+            break;
+
+        case BC_CALL:
+            backend_c_line(back, depth, "p[0] = bf_call(func_pos);");
+            break;
+
+        case BC_RETURN:
+            backend_c_line(back, depth, "return p[0];");
+            break;
+
+        case BC_TAIL_CALL:
+            backend_c_line(back, depth, "return bf_call(func_pos);");
+            break;
+
+        case BC_SYS_CALL:
+            backend_c_line(back, depth, "bf_sys_call(p, &tape[TAPE_SIZE]);");
+            break;
+
+        case BC_SET:
+            backend_c_line(back, depth, "p[%d] = %d;", instr->offset, instr->arg);
+            break;
+
+        case BC_MUL:
+            // Unsigned, so that wide cells wrap instead of overflowing int.
+            backend_c_line(back, depth, "p[%d] += p[0] * %uu;", instr->offset, (uint32_t) instr->arg);
+            break;
+
+        case BC_SCAN:
+            backend_c_write_scan(back, depth, instr->arg);
+            break;
+
+        case BC_CALL_DIRECT:
+            backend_c_line(back, depth, "p[0] = bf_func_%d();", instr->arg);
+            break;
+
+        case BC_TAIL_CALL_DIRECT:
+            backend_c_line(back, depth, "return bf_func_%d();", instr->arg);
+            break;
+
+        case BC_ADD_VEC:
+            backend_c_write_add_vec(back, depth, instr->offset, &back->program->vecs[instr->arg]);
+            break;
+
+        default:
+            return -1;
+            break;
+    }
+
+    return 0;
+}
+
+static int8_t
+backend_c_write_func(struct backend_c *back, int32_t index)
+{
+    const struct bc_func *func = &back->program->funcs[index];
+
+    backend_c_line(back, 0, "static cell");
+    backend_c_line(back, 0, "bf_func_%d(void)", index);
+    backend_c_line(back, 0, "{");
+    backend_c_line(back, 1, "cell tape[TAPE_SIZE] = {0};");
+    backend_c_line(back, 1, "cell *p = tape;");
+    backend_c_line(back, 1, "uint32_t func_pos = 0;");
+    backend_c_line(back, 1, "(void) func_pos;");
+    backend_c_line(back, 0, "");
+
+    int32_t depth = 1;
+    for (int32_t pc = 0; pc < func->code_len; pc++) {
+        const struct bc_instr *instr = &func->code[pc];
+
+        if (instr->op == BC_JNZ) {
+            depth--;
+        }
+
+        int8_t err = backend_c_write_instr(back, depth, instr);
+        if (err) {
+            return -1;
+        }
+
+        if (instr->op == BC_JZ) {
+            depth++;
+        }
+    }
+
+    backend_c_line(back, 0, "}");
+    backend_c_line(back, 0, "");
+
+    return 0;
+}
+
+int8_t
+backend_c_write_(void *back_)
+{
+    struct backend_c *back = back_;
+    if (!back || !back->file || !back->program) {
+        return -1;
+    }
+
+    if (back->program->funcs_num == 0) {
+        backend_c_line(back, 0, "int");
+        backend_c_line(back, 0, "main(void)");
+        backend_c_line(back, 0, "{");
+        backend_c_line(back, 1, "return 0;");
+        backend_c_line(back, 0, "}");
+
+        return ferror(back->file) ? -1 : 0;
+    }
+
+    backend_c_write_prelude(back);
+
+    for (int32_t i = 0; i < back->program->funcs_num; i++) {
+        int8_t err = backend_c_write_func(back, i);
+        if (err) {
+            return -1;
+        }
+    }
+
+    backend_c_line(back, 0, "int");
+    backend_c_line(back, 0, "main(void)");
+    backend_c_line(back, 0, "{");
+    backend_c_line(back, 1, "bf_func_0();");
+    backend_c_line(back, 1, "return 0;");
+    backend_c_line(back, 0, "}");
+
+    if (ferror(back->file)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+void
+backend_c_free(void *back_)
+{
+    (void) back_;
+}
\ No newline at end of file
@@ -0,0 +1,205 @@
+/*
+ * See compiler/include/backend_linux_x64.h for details.
+ *
+ * The output is a static ELF64 executable with a single R+X PT_LOAD segment
+ * that maps the whole file, the generated code is position independent and
+ * needs no relocations.
+ *
+ * Zherdev, 2021
+ */
+
+#include "backend_linux_x64.h"
+
+#include <string.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+int8_t
+backend_linux_x64_open_file(void *back_, const char *filename)
+{
+    struct backend_linux_x64 *back = back_;
+    if (!back || !filename) {
+        return -1;
+    }
+
+    int32_t fd = open(filename, O_WRONLY | O_TRUNC | O_CREAT, 0755);
+    if (fd == -1) {
+        return -1;
+    }
+    back->fd = fd;
+
+    return 0;
+}
+
+int8_t
+backend_linux_x64_close_file(void *back_)
+{
+    struct backend_linux_x64 *back = back_;
+    if (!back) {
+        return -1;
+    }
+
+    int8_t err = close(back->fd);
+    if (err) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+backend_linux_x64_prepare_header(struct backend_linux_x64 *back)
+{
+    Elf64_Ehdr *header = &back->header;
+
+    memset(header, 0, sizeof(*header));
+
+    memcpy(header->e_ident, ELFMAG, SELFMAG);
+    header->e_ident[EI_CLASS] = ELFCLASS64;
+    header->e_ident[EI_DATA] = ELFDATA2LSB;
+    header->e_ident[EI_VERSION] = EV_CURRENT;
+    header->e_ident[EI_OSABI] = ELFOSABI_SYSV;
+
+    header->e_type = ET_EXEC;
+    header->e_machine = EM_X86_64;
+    header->e_version = EV_CURRENT;
+    header->e_entry = BACKEND_LINUX_X64_BASE_ADDR
+            + back->text_offset
+            + back->gen.entry_offset;
+    header->e_phoff = sizeof(*header);
+    header->e_shoff = 0;
+    header->e_flags = 0;
+    header->e_ehsize = sizeof(*header);
+    header->e_phentsize = sizeof(Elf64_Phdr);
+    header->e_phnum = 2;
+    header->e_shentsize = 0;
+    header->e_shnum = 0;
+    header->e_shstrndx = SHN_UNDEF;
+}
+
+static void
+backend_linux_x64_prepare_ph_text(struct backend_linux_x64 *back)
+{
+    Elf64_Phdr *ph = &back->ph_text;
+
+    memset(ph, 0, sizeof(*ph));
+
+    ph->p_type = PT_LOAD;
+    ph->p_flags = PF_R | PF_X;
+    ph->p_offset = 0;
+    ph->p_vaddr = BACKEND_LINUX_X64_BASE_ADDR;
+    ph->p_paddr = BACKEND_LINUX_X64_BASE_ADDR;
+    ph->p_filesz = back->text_offset + back->gen.code_len;
+    ph->p_memsz = ph->p_filesz;
+    ph->p_align = 0x1000;
+}
+
+static void
+backend_linux_x64_prepare_ph_stack(struct backend_linux_x64 *back)
+{
+    Elf64_Phdr *ph = &back->ph_stack;
+
+    memset(ph, 0, sizeof(*ph));
+
+    ph->p_type = PT_GNU_STACK;
+    ph->p_flags = PF_R | PF_W;
+    ph->p_align = 0x10;
+}
+
+int8_t
+backend_linux_x64_prepare(void *back_, struct bc_program *program)
+{
+    struct backend_linux_x64 *back = back_;
+    if (!back || !program) {
+        return -1;
+    }
+
+    int8_t err = codegen_x64_init(&back->gen, CODEGEN_X64_TARGET_STANDALONE, NULL);
+    if (err) {
+        return -1;
+    }
+
+    err = codegen_x64_compile(&back->gen, program);
+    if (err) {
+        return -1;
+    }
+
+    const uint64_t text_align = 16;
+    uint64_t headers_size = sizeof(back->header)
+            + sizeof(back->ph_text)
+            + sizeof(back->ph_stack);
+    back->text_offset = (headers_size + text_align - 1) / text_align * text_align;
+
+    backend_linux_x64_prepare_header(back);
+    backend_linux_x64_prepare_ph_text(back);
+    backend_linux_x64_prepare_ph_stack(back);
+
+    return 0;
+}
+
+static int8_t
+backend_linux_x64_write_all(int32_t fd, const void *buff, uint64_t size)
+{
+    const uint8_t *bytes = buff;
+
+    while (size > 0) {
+        ssize_t res = write(fd, bytes, size);
+        if (res <= 0) {
+            return -1;
+        }
+
+        bytes += res;
+        size -= res;
+    }
+
+    return 0;
+}
+
+int8_t
+backend_linux_x64_write_(void *back_)
+{
+    struct backend_linux_x64 *back = back_;
+    if (!back || !back->gen.code) {
+        return -1;
+    }
+
+    int8_t err = backend_linux_x64_write_all(back->fd, &back->header, sizeof(back->header));
+    if (err) {
+        return -1;
+    }
+
+    err = backend_linux_x64_write_all(back->fd, &back->ph_text, sizeof(back->ph_text));
+    if (err) {
+        return -1;
+    }
+
+    err = backend_linux_x64_write_all(back->fd, &back->ph_stack, sizeof(back->ph_stack));
+    if (err) {
+        return -1;
+    }
+
+    const uint8_t padding[16] = {0};
+    uint64_t padding_size = back->text_offset
+            - sizeof(back->header)
+            - sizeof(back->ph_text)
+            - sizeof(back->ph_stack);
+
+    err = backend_linux_x64_write_all(back->fd, padding, padding_size);
+    if (err) {
+        return -1;
+    }
+
+    return backend_linux_x64_write_all(back->fd, back->gen.code, back->gen.code_len);
+}
+
+void
+backend_linux_x64_free(void *back_)
+{
+    struct backend_linux_x64 *back = back_;
+    if (!back) {
+        return;
+    }
+
+    codegen_x64_free(&back->gen);
+}
\ No newline at end of file
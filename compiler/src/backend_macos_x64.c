@@ -174,10 +174,10 @@ backend_macos_x64_prepare_cmd_symtab(struct backend_macos_x64 *back)
 }
 
 int8_t
-backend_macos_x64_prepare(void *back_)
+backend_macos_x64_prepare(void *back_, struct bc_program *program)
 {
     struct backend_macos_x64 *back = back_;
-    if (!back) {
+    if (!back || !program) {
         return -1;
     }
 
@@ -0,0 +1,1355 @@
+/*
+ * See compiler/include/codegen_x64.h for details.
+ *
+ * Register usage of the generated code:
+ *     rbx - head pointer into the tape,
+ *     r12 - func_pos of the current function,
+ *     r13 - struct codegen_x64_ctx * (JIT), the output buffer (standalone),
+ *     r14 - tape begin of the current function,
+ *     r15 - rightmost head position of the current function (JIT only).
+ * A standalone Brainfunction keeps its tape on the native stack. The JIT
+ * code gets its tapes from the runtime frames and runs on a stack of its
+ * own.
+ *
+ * Zherdev, 2021
+ */
+
+#include "codegen_x64.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CODEGEN_X64_EMIT(gen, ...) \
+    do { \
+        const uint8_t bytes_[] = {__VA_ARGS__}; \
+        codegen_x64_emit((gen), bytes_, sizeof(bytes_)); \
+    } while (0)
+
+#define CODEGEN_X64_ERROR_EXIT_CODE (253)
+
+static void
+codegen_x64_emit(struct codegen_x64 *gen, const uint8_t *bytes, int32_t bytes_num)
+{
+    if (gen->err) {
+        return;
+    }
+
+    if (gen->code_len + bytes_num > gen->code_max_len) {
+        int32_t new_size = gen->code_max_len * 2 + bytes_num;
+
+        uint8_t *code = realloc(gen->code, new_size);
+        if (!code) {
+            gen->err = 1;
+            return;
+        }
+
+        gen->code = code;
+        gen->code_max_len = new_size;
+    }
+
+    memcpy(&gen->code[gen->code_len], bytes, bytes_num);
+    gen->code_len += bytes_num;
+}
+
+static void
+codegen_x64_emit_u32(struct codegen_x64 *gen, uint32_t value)
+{
+    CODEGEN_X64_EMIT(gen, value, value >> 8, value >> 16, value >> 24);
+}
+
+static void
+codegen_x64_emit_u64(struct codegen_x64 *gen, uint64_t value)
+{
+    codegen_x64_emit_u32(gen, value);
+    codegen_x64_emit_u32(gen, value >> 32);
+}
+
+static void
+codegen_x64_patch_u32(struct codegen_x64 *gen, int32_t pos, uint32_t value)
+{
+    if (gen->err) {
+        return;
+    }
+
+    gen->code[pos] = value;
+    gen->code[pos + 1] = value >> 8;
+    gen->code[pos + 2] = value >> 16;
+    gen->code[pos + 3] = value >> 24;
+}
+
+// rel32 operand that points to an already known code offset.
+static void
+codegen_x64_emit_rel32(struct codegen_x64 *gen, int32_t target)
+{
+    codegen_x64_emit_u32(gen, target - (gen->code_len + 4));
+}
+
+// rel32 operand that points to the bytecode instruction at target pc.
+static void
+codegen_x64_emit_rel32_pc(struct codegen_x64 *gen, int32_t target)
+{
+    if (gen->fixups_num >= gen->fixups_max_num) {
+        int32_t new_size = gen->fixups_max_num * 2 + 16;
+
+        struct codegen_x64_fixup *fixups = realloc(gen->fixups, new_size * sizeof(*fixups));
+        if (!fixups) {
+            gen->err = 1;
+            return;
+        }
+
+        gen->fixups = fixups;
+        gen->fixups_max_num = new_size;
+    }
+
+    struct codegen_x64_fixup *fixup = &gen->fixups[gen->fixups_num++];
+    fixup->pos = gen->code_len;
+    fixup->target = target;
+
+    codegen_x64_emit_u32(gen, 0);
+}
+
+// rel32 operand that points to the function at index, which may not have
+// been compiled yet.
+static void
+codegen_x64_emit_rel32_func(struct codegen_x64 *gen, int32_t index)
+{
+    if (gen->func_fixups_num >= gen->func_fixups_max_num) {
+        int32_t new_size = gen->func_fixups_max_num * 2 + 16;
+
+        struct codegen_x64_fixup *fixups = realloc(gen->func_fixups, new_size * sizeof(*fixups));
+        if (!fixups) {
+            gen->err = 1;
+            return;
+        }
+
+        gen->func_fixups = fixups;
+        gen->func_fixups_max_num = new_size;
+    }
+
+    struct codegen_x64_fixup *fixup = &gen->func_fixups[gen->func_fixups_num++];
+    fixup->pos = gen->code_len;
+    fixup->target = index;
+
+    codegen_x64_emit_u32(gen, 0);
+}
+
+// rel32 operand that points to the function table.
+static void
+codegen_x64_emit_rel32_table(struct codegen_x64 *gen)
+{
+    if (gen->table_fixups_num >= gen->table_fixups_max_num) {
+        int32_t new_size = gen->table_fixups_max_num * 2 + 16;
+
+        int32_t *fixups = realloc(gen->table_fixups, new_size * sizeof(*fixups));
+        if (!fixups) {
+            gen->err = 1;
+            return;
+        }
+
+        gen->table_fixups = fixups;
+        gen->table_fixups_max_num = new_size;
+    }
+
+    gen->table_fixups[gen->table_fixups_num++] = gen->code_len;
+
+    codegen_x64_emit_u32(gen, 0);
+}
+
+// ModRM (and displacement) of a [rbx + disp] memory operand.
+static void
+codegen_x64_emit_cell_operand(struct codegen_x64 *gen, uint8_t reg, int32_t disp)
+{
+    const uint8_t rm_rbx = 3;
+
+    if (disp == 0) {
+        CODEGEN_X64_EMIT(gen, (reg << 3) | rm_rbx);
+    } else if (disp >= INT8_MIN && disp <= INT8_MAX) {
+        CODEGEN_X64_EMIT(gen, 0x40 | (reg << 3) | rm_rbx, disp);
+    } else {
+        CODEGEN_X64_EMIT(gen, 0x80 | (reg << 3) | rm_rbx);
+        codegen_x64_emit_u32(gen, disp);
+    }
+}
+
+// Short jump forward, the label is placed by codegen_x64_place_label8 with
+// the returned position of the rel8 operand.
+static int32_t
+codegen_x64_emit_jump8(struct codegen_x64 *gen, uint8_t opcode)
+{
+    CODEGEN_X64_EMIT(gen, opcode, 0);
+    return gen->code_len - 1;
+}
+
+static void
+codegen_x64_place_label8(struct codegen_x64 *gen, int32_t pos)
+{
+    int32_t rel = gen->code_len - (pos + 1);
+    if (gen->err || rel > INT8_MAX) {
+        gen->err = 1;
+        return;
+    }
+
+    gen->code[pos] = rel;
+}
+
+// Short jump back to an already known code offset.
+static void
+codegen_x64_emit_jump8_back(struct codegen_x64 *gen, uint8_t opcode, int32_t target)
+{
+    int32_t rel = target - (gen->code_len + 2);
+    if (rel < INT8_MIN) {
+        gen->err = 1;
+        return;
+    }
+
+    CODEGEN_X64_EMIT(gen, opcode, rel);
+}
+
+// Bytes taken by cells, the generated code addresses the tape in bytes.
+static int32_t
+codegen_x64_cells(struct codegen_x64 *gen, int64_t cells)
+{
+    int64_t bytes = cells * gen->cell_size;
+    if (bytes < INT32_MIN || bytes > INT32_MAX) {
+        gen->err = 1;
+        return 0;
+    }
+
+    return bytes;
+}
+
+// log2 of the cell width, the scale of a cell index.
+static uint8_t
+codegen_x64_cell_shift(struct codegen_x64 *gen)
+{
+    return gen->cell_size == 4 ? 2 : gen->cell_size - 1;
+}
+
+// Operand size prefix and opcode of an instruction on a cell, op8 is the
+// byte form of the instruction and op the word and dword one.
+static void
+codegen_x64_emit_cell_opcode(struct codegen_x64 *gen, uint8_t op8, uint8_t op)
+{
+    if (gen->cell_size == 2) {
+        CODEGEN_X64_EMIT(gen, 0x66);
+    }
+    CODEGEN_X64_EMIT(gen, gen->cell_size == 1 ? op8 : op);
+}
+
+static void
+codegen_x64_emit_cell_imm(struct codegen_x64 *gen, uint32_t value)
+{
+    if (gen->cell_size == 1) {
+        CODEGEN_X64_EMIT(gen, value);
+    } else if (gen->cell_size == 2) {
+        CODEGEN_X64_EMIT(gen, value, value >> 8);
+    } else {
+        codegen_x64_emit_u32(gen, value);
+    }
+}
+
+// Loads the cell at [base + disp] zero extended into the dword register
+// reg, base is neither rsp nor rbp.
+static void
+codegen_x64_emit_load_cell(struct codegen_x64 *gen, uint8_t reg, uint8_t base, int8_t disp)
+{
+    if (reg >= 8) {
+        // REX.R
+        CODEGEN_X64_EMIT(gen, 0x44);
+    }
+
+    if (gen->cell_size == 4) {
+        // mov r32, dword [base + disp]
+        CODEGEN_X64_EMIT(gen, 0x8B);
+    } else {
+        // movzx r32, byte/word [base + disp]
+        CODEGEN_X64_EMIT(gen, 0x0F, gen->cell_size == 1 ? 0xB6 : 0xB7);
+    }
+
+    uint8_t modrm = ((reg & 7) << 3) | base;
+    if (disp == 0) {
+        CODEGEN_X64_EMIT(gen, modrm);
+    } else {
+        CODEGEN_X64_EMIT(gen, 0x40 | modrm, disp);
+    }
+}
+
+// mov [rbx + disp], al/ax/eax
+static void
+codegen_x64_emit_store_cell(struct codegen_x64 *gen, int32_t disp)
+{
+    codegen_x64_emit_cell_opcode(gen, 0x88, 0x89);
+    codegen_x64_emit_cell_operand(gen, 0, disp);
+}
+
+static void
+codegen_x64_emit_helper_call(struct codegen_x64 *gen, const void *helper)
+{
+    // mov rax, imm64; call rax
+    CODEGEN_X64_EMIT(gen, 0x48, 0xB8);
+    codegen_x64_emit_u64(gen, (uint64_t) (uintptr_t) helper);
+    CODEGEN_X64_EMIT(gen, 0xFF, 0xD0);
+}
+
+static void
+codegen_x64_emit_cmp_cell_zero(struct codegen_x64 *gen)
+{
+    // cmp byte/word/dword [rbx], 0
+    if (gen->cell_size == 1) {
+        CODEGEN_X64_EMIT(gen, 0x80, 0x3B, 0x00);
+        return;
+    }
+    if (gen->cell_size == 2) {
+        CODEGEN_X64_EMIT(gen, 0x66);
+    }
+    CODEGEN_X64_EMIT(gen, 0x83, 0x3B, 0x00);
+}
+
+static void
+codegen_x64_emit_jump_error(struct codegen_x64 *gen, uint8_t jcc)
+{
+    CODEGEN_X64_EMIT(gen, 0x0F, jcc);
+    codegen_x64_emit_rel32(gen, gen->error_offset);
+}
+
+// The same for an access outside of the tape.
+static void
+codegen_x64_emit_jump_bounds_error(struct codegen_x64 *gen, uint8_t jcc)
+{
+    CODEGEN_X64_EMIT(gen, 0x0F, jcc);
+    codegen_x64_emit_rel32(gen, gen->bounds_error_offset);
+}
+
+// Loads the address of the function selected by r12 from the function
+// table into rax.
+static void
+codegen_x64_emit_func_address(struct codegen_x64 *gen)
+{
+    // cmp r12d, funcs_num; jae error
+    CODEGEN_X64_EMIT(gen, 0x41, 0x81, 0xFC);
+    codegen_x64_emit_u32(gen, gen->funcs_num);
+    codegen_x64_emit_jump_error(gen, 0x83);
+
+    // lea rcx, [rip + table]
+    CODEGEN_X64_EMIT(gen, 0x48, 0x8D, 0x0D);
+    codegen_x64_emit_rel32_table(gen);
+
+    // movsxd rax, dword [rcx + r12 * 4]; add rax, rcx
+    CODEGEN_X64_EMIT(gen, 0x4A, 0x63, 0x04, 0xA1);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x01, 0xC8);
+}
+
+// Calls the function selected by r12, the return code is left in the low
+// cell of eax.
+static void
+codegen_x64_emit_dynamic_call(struct codegen_x64 *gen)
+{
+    codegen_x64_emit_func_address(gen);
+
+    // call rax
+    CODEGEN_X64_EMIT(gen, 0xFF, 0xD0);
+}
+
+// Standalone only, writes out the output buffer at r13: its length in the
+// first qword, the bytes after it. A failed write exits with the error
+// code, rbx, r12, r13 and r14 are preserved.
+static void
+codegen_x64_emit_flush_routine(struct codegen_x64 *gen)
+{
+    gen->flush_offset = gen->code_len;
+
+    // lea rsi, [r13 + 8]; mov rdx, [r13]; mov qword [r13], 0
+    CODEGEN_X64_EMIT(gen, 0x49, 0x8D, 0x75, 0x08);
+    CODEGEN_X64_EMIT(gen, 0x49, 0x8B, 0x55, 0x00);
+    CODEGEN_X64_EMIT(gen, 0x49, 0xC7, 0x45, 0x00, 0x00, 0x00, 0x00, 0x00);
+
+    // loop: test rdx, rdx; jz done; write(1, rsi, rdx)
+    int32_t loop = gen->code_len;
+    CODEGEN_X64_EMIT(gen, 0x48, 0x85, 0xD2);
+    int32_t done = codegen_x64_emit_jump8(gen, 0x74);
+    CODEGEN_X64_EMIT(gen, 0xB8, 1, 0, 0, 0);
+    CODEGEN_X64_EMIT(gen, 0xBF, 1, 0, 0, 0);
+    CODEGEN_X64_EMIT(gen, 0x0F, 0x05);
+
+    // cmp rax, -EINTR; je loop; test rax, rax; jle fail
+    CODEGEN_X64_EMIT(gen, 0x48, 0x83, 0xF8, 0xFC);
+    codegen_x64_emit_jump8_back(gen, 0x74, loop);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x85, 0xC0);
+    int32_t fail = codegen_x64_emit_jump8(gen, 0x7E);
+
+    // add rsi, rax; sub rdx, rax; jmp loop
+    CODEGEN_X64_EMIT(gen, 0x48, 0x01, 0xC6);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x29, 0xC2);
+    codegen_x64_emit_jump8_back(gen, 0xEB, loop);
+
+    // fail: exit(CODEGEN_X64_ERROR_EXIT_CODE)
+    codegen_x64_place_label8(gen, fail);
+    CODEGEN_X64_EMIT(gen, 0xBF, CODEGEN_X64_ERROR_EXIT_CODE, 0, 0, 0);
+    CODEGEN_X64_EMIT(gen, 0xB8, 60, 0, 0, 0);
+    CODEGEN_X64_EMIT(gen, 0x0F, 0x05);
+
+    // done: ret
+    codegen_x64_place_label8(gen, done);
+    CODEGEN_X64_EMIT(gen, 0xC3);
+}
+
+static void
+codegen_x64_emit_call_flush(struct codegen_x64 *gen)
+{
+    // call flush
+    CODEGEN_X64_EMIT(gen, 0xE8);
+    codegen_x64_emit_rel32(gen, gen->flush_offset);
+}
+
+static void
+codegen_x64_emit_entry(struct codegen_x64 *gen)
+{
+    gen->entry_offset = gen->code_len;
+
+    if (gen->target == CODEGEN_X64_TARGET_STANDALONE) {
+        // sub rsp, output_bytes; mov r13, rsp; mov qword [r13], 0
+        CODEGEN_X64_EMIT(gen, 0x48, 0x81, 0xEC);
+        codegen_x64_emit_u32(gen, CODEGEN_X64_OUTPUT_SIZE + 16);
+        CODEGEN_X64_EMIT(gen, 0x49, 0x89, 0xE5);
+        CODEGEN_X64_EMIT(gen, 0x49, 0xC7, 0x45, 0x00, 0x00, 0x00, 0x00, 0x00);
+
+        if (gen->funcs_num > 0) {
+            // xor r12d, r12d
+            CODEGEN_X64_EMIT(gen, 0x45, 0x31, 0xE4);
+            codegen_x64_emit_dynamic_call(gen);
+        }
+
+        // call flush; exit(0)
+        codegen_x64_emit_call_flush(gen);
+        CODEGEN_X64_EMIT(gen, 0x31, 0xFF);
+        CODEGEN_X64_EMIT(gen, 0xB8, 60, 0, 0, 0);
+        CODEGEN_X64_EMIT(gen, 0x0F, 0x05);
+        return;
+    }
+
+    // push rbx; push r12; push r13; push r14; sub rsp, 8
+    CODEGEN_X64_EMIT(gen, 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x83, 0xEC, 0x08);
+
+    // mov r13, rdi; mov [r13], rsp; mov r12d, esi; mov rsp, [r13 + 8]
+    CODEGEN_X64_EMIT(gen, 0x49, 0x89, 0xFD);
+    CODEGEN_X64_EMIT(gen, 0x49, 0x89, 0x65, 0x00);
+    CODEGEN_X64_EMIT(gen, 0x41, 0x89, 0xF4);
+    CODEGEN_X64_EMIT(gen, 0x49, 0x8B, 0x65, 0x08);
+
+    codegen_x64_emit_dynamic_call(gen);
+
+    // movzx eax, al/ax or mov eax, eax; mov rsp, [r13]
+    if (gen->cell_size == 4) {
+        CODEGEN_X64_EMIT(gen, 0x89, 0xC0);
+    } else {
+        CODEGEN_X64_EMIT(gen, 0x0F, gen->cell_size == 1 ? 0xB6 : 0xB7, 0xC0);
+    }
+    CODEGEN_X64_EMIT(gen, 0x49, 0x8B, 0x65, 0x00);
+
+    // add rsp, 8; pop r14; pop r13; pop r12; pop rbx; ret
+    CODEGEN_X64_EMIT(gen, 0x48, 0x83, 0xC4, 0x08);
+    CODEGEN_X64_EMIT(gen, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3);
+}
+
+static void
+codegen_x64_emit_error(struct codegen_x64 *gen)
+{
+    gen->bounds_error_offset = gen->code_len;
+    gen->error_offset = gen->code_len;
+
+    if (gen->target == CODEGEN_X64_TARGET_STANDALONE) {
+        // The output written before the error goes out first.
+        // call flush; exit(CODEGEN_X64_ERROR_EXIT_CODE)
+        codegen_x64_emit_call_flush(gen);
+        CODEGEN_X64_EMIT(gen, 0xBF, CODEGEN_X64_ERROR_EXIT_CODE, 0, 0, 0);
+        CODEGEN_X64_EMIT(gen, 0xB8, 60, 0, 0, 0);
+        CODEGEN_X64_EMIT(gen, 0x0F, 0x05);
+        return;
+    }
+
+    // bounds_error: mov qword [r13 + 32], 1
+    CODEGEN_X64_EMIT(gen, 0x49, 0xC7, 0x45, 0x20, 0x01, 0x00, 0x00, 0x00);
+
+    // Unwinds every Brainfunction frame at once.
+    // error: mov rsp, [r13]; mov rax, -1
+    gen->error_offset = gen->code_len;
+    CODEGEN_X64_EMIT(gen, 0x49, 0x8B, 0x65, 0x00);
+    CODEGEN_X64_EMIT(gen, 0x48, 0xC7, 0xC0, 0xFF, 0xFF, 0xFF, 0xFF);
+
+    // add rsp, 8; pop r14; pop r13; pop r12; pop rbx; ret
+    CODEGEN_X64_EMIT(gen, 0x48, 0x83, 0xC4, 0x08);
+    CODEGEN_X64_EMIT(gen, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3);
+}
+
+// reg = r14 + tape_bytes, the end of the current tape.
+static void
+codegen_x64_emit_tape_end(struct codegen_x64 *gen, uint8_t reg)
+{
+    if (gen->target == CODEGEN_X64_TARGET_JIT) {
+        // mov reg, [r13 + 24]; add reg, r14
+        CODEGEN_X64_EMIT(gen, 0x49, 0x8B, 0x45 | (reg << 3), 0x18);
+        CODEGEN_X64_EMIT(gen, 0x4C, 0x01, 0xF0 | reg);
+        return;
+    }
+
+    // lea reg, [r14 + tape_bytes]
+    CODEGEN_X64_EMIT(gen, 0x49, 0x8D, 0x86 | (reg << 3));
+    codegen_x64_emit_u32(gen, gen->tape_bytes);
+}
+
+// JIT only, keeps r15 at the rightmost head position after a move right.
+static void
+codegen_x64_emit_head_max(struct codegen_x64 *gen)
+{
+    if (gen->target != CODEGEN_X64_TARGET_JIT || !gen->head_tracked) {
+        return;
+    }
+
+    // cmp rbx, r15; cmova r15, rbx
+    CODEGEN_X64_EMIT(gen, 0x4C, 0x39, 0xFB);
+    CODEGEN_X64_EMIT(gen, 0x4C, 0x0F, 0x47, 0xFB);
+}
+
+// JIT only, moves r15 up to the head position cells right of the head.
+static void
+codegen_x64_emit_head_bound(struct codegen_x64 *gen, int64_t cells)
+{
+    if (gen->target != CODEGEN_X64_TARGET_JIT) {
+        return;
+    }
+
+    // lea rax, [rbx + cells_bytes]; cmp rax, r15; cmova r15, rax
+    CODEGEN_X64_EMIT(gen, 0x48, 0x8D, 0x83);
+    codegen_x64_emit_u32(gen, codegen_x64_cells(gen, cells));
+    CODEGEN_X64_EMIT(gen, 0x4C, 0x39, 0xF8);
+    CODEGEN_X64_EMIT(gen, 0x4C, 0x0F, 0x47, 0xF8);
+}
+
+// JIT only, hands the frame back to the runtime with the range its head
+// reached, so that the next user of the tape gets only that range zeroed.
+static void
+codegen_x64_emit_frame_pop(struct codegen_x64 *gen)
+{
+    // mov rdi, r13; mov rsi, r15; call pop
+    CODEGEN_X64_EMIT(gen, 0x4C, 0x89, 0xEF);
+    CODEGEN_X64_EMIT(gen, 0x4C, 0x89, 0xFE);
+    codegen_x64_emit_helper_call(gen, gen->helpers->pop);
+}
+
+static void
+codegen_x64_emit_prologue(struct codegen_x64 *gen, int32_t index)
+{
+    if (gen->target == CODEGEN_X64_TARGET_JIT) {
+        // cmp rsp, [r13 + 16]; jb error
+        CODEGEN_X64_EMIT(gen, 0x49, 0x3B, 0x65, 0x10);
+        codegen_x64_emit_jump_error(gen, 0x82);
+
+        // push rbx; push r12; push r14; push r15; sub rsp, 8
+        CODEGEN_X64_EMIT(gen, 0x53, 0x41, 0x54, 0x41, 0x56, 0x41, 0x57);
+        CODEGEN_X64_EMIT(gen, 0x48, 0x83, 0xEC, 0x08);
+
+        // mov rdi, r13; mov esi, index; call push; test rax, rax; jz error
+        CODEGEN_X64_EMIT(gen, 0x4C, 0x89, 0xEF);
+        CODEGEN_X64_EMIT(gen, 0xBE);
+        codegen_x64_emit_u32(gen, index);
+        codegen_x64_emit_helper_call(gen, gen->helpers->push);
+        CODEGEN_X64_EMIT(gen, 0x48, 0x85, 0xC0);
+        codegen_x64_emit_jump_error(gen, 0x84);
+
+        // mov rbx, rax; mov r14, rax; mov r15, rax; xor r12d, r12d
+        CODEGEN_X64_EMIT(gen, 0x48, 0x89, 0xC3);
+        CODEGEN_X64_EMIT(gen, 0x49, 0x89, 0xC6);
+        CODEGEN_X64_EMIT(gen, 0x49, 0x89, 0xC7);
+        CODEGEN_X64_EMIT(gen, 0x45, 0x31, 0xE4);
+        return;
+    }
+
+    // push rbx; push r12; push r14; sub rsp, tape_bytes
+    CODEGEN_X64_EMIT(gen, 0x53, 0x41, 0x54, 0x41, 0x56);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x81, 0xEC);
+    codegen_x64_emit_u32(gen, gen->tape_bytes);
+
+    // mov rdi, rsp; mov ecx, tape_bytes / 8; xor eax, eax; rep stosq
+    CODEGEN_X64_EMIT(gen, 0x48, 0x89, 0xE7);
+    CODEGEN_X64_EMIT(gen, 0xB9);
+    codegen_x64_emit_u32(gen, gen->tape_bytes / 8);
+    CODEGEN_X64_EMIT(gen, 0x31, 0xC0);
+    CODEGEN_X64_EMIT(gen, 0xF3, 0x48, 0xAB);
+
+    // mov rbx, rsp; mov r14, rsp; xor r12d, r12d
+    CODEGEN_X64_EMIT(gen, 0x48, 0x89, 0xE3);
+    CODEGEN_X64_EMIT(gen, 0x49, 0x89, 0xE6);
+    CODEGEN_X64_EMIT(gen, 0x45, 0x31, 0xE4);
+}
+
+// Releases the frame and the native stack of the current function, rax is
+// preserved.
+static void
+codegen_x64_emit_frame_release(struct codegen_x64 *gen)
+{
+    if (gen->target == CODEGEN_X64_TARGET_JIT) {
+        // mov [rsp], rax; pop the frame; mov rax, [rsp]
+        CODEGEN_X64_EMIT(gen, 0x48, 0x89, 0x04, 0x24);
+        codegen_x64_emit_frame_pop(gen);
+        CODEGEN_X64_EMIT(gen, 0x48, 0x8B, 0x04, 0x24);
+
+        // add rsp, 8; pop r15; pop r14; pop r12; pop rbx
+        CODEGEN_X64_EMIT(gen, 0x48, 0x83, 0xC4, 0x08);
+        CODEGEN_X64_EMIT(gen, 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5C, 0x5B);
+        return;
+    }
+
+    // add rsp, tape_bytes; pop r14; pop r12; pop rbx
+    CODEGEN_X64_EMIT(gen, 0x48, 0x81, 0xC4);
+    codegen_x64_emit_u32(gen, gen->tape_bytes);
+    CODEGEN_X64_EMIT(gen, 0x41, 0x5E, 0x41, 0x5C, 0x5B);
+}
+
+static void
+codegen_x64_emit_epilogue(struct codegen_x64 *gen)
+{
+    // load eax, [rbx]; release; ret
+    codegen_x64_emit_load_cell(gen, 0, 3, 0);
+    codegen_x64_emit_frame_release(gen);
+    CODEGEN_X64_EMIT(gen, 0xC3);
+}
+
+// Releases the frame and jumps to the function selected by r12, which then
+// returns straight to the caller.
+static void
+codegen_x64_emit_tail_call(struct codegen_x64 *gen)
+{
+    // release; jmp rax
+    codegen_x64_emit_func_address(gen);
+    codegen_x64_emit_frame_release(gen);
+    CODEGEN_X64_EMIT(gen, 0xFF, 0xE0);
+}
+
+static void
+codegen_x64_emit_direct_tail_call(struct codegen_x64 *gen, int32_t index)
+{
+    // release; jmp func
+    codegen_x64_emit_frame_release(gen);
+    CODEGEN_X64_EMIT(gen, 0xE9);
+    codegen_x64_emit_rel32_func(gen, index);
+}
+
+// Adds the chunk of deltas at code offset deltas to the cells at rbx + disp.
+static void
+codegen_x64_emit_add_chunk(struct codegen_x64 *gen, int32_t disp, int32_t deltas, int32_t chunk)
+{
+    // paddb/paddw/paddd
+    uint8_t padd = gen->cell_size == 1 ? 0xFC : (gen->cell_size == 2 ? 0xFD : 0xFE);
+
+    if (chunk == 32 && gen->avx2) {
+        // vmovdqu ymm0, [rbx + disp]; vmovdqu ymm1, [rip + deltas]
+        CODEGEN_X64_EMIT(gen, 0xC5, 0xFE, 0x6F);
+        codegen_x64_emit_cell_operand(gen, 0, disp);
+        CODEGEN_X64_EMIT(gen, 0xC5, 0xFE, 0x6F, 0x0D);
+        codegen_x64_emit_rel32(gen, deltas);
+
+        // vpadd ymm0, ymm0, ymm1; vmovdqu [rbx + disp], ymm0; vzeroupper
+        CODEGEN_X64_EMIT(gen, 0xC5, 0xFD, padd, 0xC1);
+        CODEGEN_X64_EMIT(gen, 0xC5, 0xFE, 0x7F);
+        codegen_x64_emit_cell_operand(gen, 0, disp);
+        CODEGEN_X64_EMIT(gen, 0xC5, 0xF8, 0x77);
+        return;
+    }
+
+    if (chunk > 16) {
+        codegen_x64_emit_add_chunk(gen, disp, deltas, 16);
+        codegen_x64_emit_add_chunk(gen, disp + 16, deltas + 16, chunk - 16);
+        return;
+    }
+
+    // movd/movq/movdqu xmm0, [rbx + disp]; movd/movq/movdqu xmm1, [rip + deltas]
+    const uint8_t load[3] = {
+        chunk == 4 ? 0x66 : 0xF3, 0x0F, chunk == 4 ? 0x6E : (chunk == 8 ? 0x7E : 0x6F),
+    };
+    codegen_x64_emit(gen, load, sizeof(load));
+    codegen_x64_emit_cell_operand(gen, 0, disp);
+    codegen_x64_emit(gen, load, sizeof(load));
+    CODEGEN_X64_EMIT(gen, 0x0D);
+    codegen_x64_emit_rel32(gen, deltas);
+
+    // padd xmm0, xmm1; movd/movq/movdqu [rbx + disp], xmm0
+    CODEGEN_X64_EMIT(gen, 0x66, 0x0F, padd, 0xC1);
+    const uint8_t store[3] = {
+        chunk == 16 ? 0xF3 : 0x66, 0x0F, chunk == 4 ? 0x7E : (chunk == 8 ? 0xD6 : 0x7F),
+    };
+    codegen_x64_emit(gen, store, sizeof(store));
+    codegen_x64_emit_cell_operand(gen, 0, disp);
+}
+
+// The deltas are placed inline and jumped over.
+static void
+codegen_x64_emit_add_vec(struct codegen_x64 *gen, int32_t offset, const struct bc_vec *vec)
+{
+    int32_t over = codegen_x64_emit_jump8(gen, 0xEB);
+    int32_t deltas = gen->code_len;
+    codegen_x64_emit(gen, vec->deltas, vec->bytes);
+    codegen_x64_place_label8(gen, over);
+
+    codegen_x64_emit_add_chunk(gen, codegen_x64_cells(gen, offset), deltas, vec->bytes);
+}
+
+static void
+codegen_x64_emit_input(struct codegen_x64 *gen, int32_t offset)
+{
+    int32_t disp = codegen_x64_cells(gen, offset);
+
+    if (gen->target == CODEGEN_X64_TARGET_JIT) {
+        // mov rdi, r13; call input; mov [rbx + disp], al/ax/eax
+        CODEGEN_X64_EMIT(gen, 0x4C, 0x89, 0xEF);
+        codegen_x64_emit_helper_call(gen, gen->helpers->input);
+        codegen_x64_emit_store_cell(gen, disp);
+        return;
+    }
+
+    if (gen->cell_size > 1) {
+        // mov word/dword [rbx + disp], 0
+        codegen_x64_emit_cell_opcode(gen, 0xC6, 0xC7);
+        codegen_x64_emit_cell_operand(gen, 0, disp);
+        codegen_x64_emit_cell_imm(gen, 0);
+    }
+
+    // The prompt must be visible before the program blocks on input.
+    codegen_x64_emit_call_flush(gen);
+
+    // read(0, rbx + disp, 1) into the low byte, EOF and errors read as a
+    // cell of all ones like getc() does.
+    CODEGEN_X64_EMIT(gen, 0x31, 0xC0);
+    CODEGEN_X64_EMIT(gen, 0x31, 0xFF);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x8D);
+    codegen_x64_emit_cell_operand(gen, 6, disp);
+    CODEGEN_X64_EMIT(gen, 0xBA, 1, 0, 0, 0);
+    CODEGEN_X64_EMIT(gen, 0x0F, 0x05);
+
+    // test rax, rax; jg done; mov [rbx + disp], -1
+    CODEGEN_X64_EMIT(gen, 0x48, 0x85, 0xC0);
+    int32_t done = codegen_x64_emit_jump8(gen, 0x7F);
+    codegen_x64_emit_cell_opcode(gen, 0xC6, 0xC7);
+    codegen_x64_emit_cell_operand(gen, 0, disp);
+    codegen_x64_emit_cell_imm(gen, UINT32_MAX);
+    codegen_x64_place_label8(gen, done);
+}
+
+static void
+codegen_x64_emit_output(struct codegen_x64 *gen, int32_t offset)
+{
+    int32_t disp = codegen_x64_cells(gen, offset);
+
+    if (gen->target == CODEGEN_X64_TARGET_JIT) {
+        // mov rdi, r13; movzx esi, byte [rbx + disp]; call output; test eax, eax; jnz error
+        CODEGEN_X64_EMIT(gen, 0x4C, 0x89, 0xEF);
+        CODEGEN_X64_EMIT(gen, 0x0F, 0xB6);
+        codegen_x64_emit_cell_operand(gen, 6, disp);
+        codegen_x64_emit_helper_call(gen, gen->helpers->output);
+        CODEGEN_X64_EMIT(gen, 0x85, 0xC0);
+        codegen_x64_emit_jump_error(gen, 0x85);
+        return;
+    }
+
+    // mov rax, [r13]; movzx ecx, byte [rbx + disp]; mov [r13 + rax + 8], cl
+    CODEGEN_X64_EMIT(gen, 0x49, 0x8B, 0x45, 0x00);
+    CODEGEN_X64_EMIT(gen, 0x0F, 0xB6);
+    codegen_x64_emit_cell_operand(gen, 1, disp);
+    CODEGEN_X64_EMIT(gen, 0x41, 0x88, 0x4C, 0x05, 0x08);
+
+    // inc rax; mov [r13], rax; cmp rax, output_size; jb done; call flush
+    CODEGEN_X64_EMIT(gen, 0x48, 0xFF, 0xC0);
+    CODEGEN_X64_EMIT(gen, 0x49, 0x89, 0x45, 0x00);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x3D);
+    codegen_x64_emit_u32(gen, CODEGEN_X64_OUTPUT_SIZE);
+    int32_t done = codegen_x64_emit_jump8(gen, 0x72);
+    codegen_x64_emit_call_flush(gen);
+    codegen_x64_place_label8(gen, done);
+}
+
+// rax = cells between rsi and the tape end in rdx
+static void
+codegen_x64_emit_cells_left(struct codegen_x64 *gen)
+{
+    // mov rax, rdx; sub rax, rsi; shr rax, cell_shift
+    CODEGEN_X64_EMIT(gen, 0x48, 0x89, 0xD0);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x29, 0xF0);
+    if (gen->cell_size > 1) {
+        CODEGEN_X64_EMIT(gen, 0x48, 0xC1, 0xE8, codegen_x64_cell_shift(gen));
+    }
+}
+
+// Standalone only, decodes the Systemf argument block at rbx into the six
+// syscall registers and stores the result truncated to the cell width back
+// to [rbx]. The block must not cross the tape end, rbx, r12 and r14 are
+// preserved.
+static void
+codegen_x64_emit_sys_call_routine(struct codegen_x64 *gen)
+{
+    const uint8_t rax = 0, rcx = 1, rbx = 3, rsi = 6, r8 = 8, r10 = 10, r11 = 11;
+    int8_t size = gen->cell_size;
+
+    gen->sys_call_offset = gen->code_len;
+
+    // The syscall may write to stdout or never return, so the output goes
+    // first.
+    codegen_x64_emit_call_flush(gen);
+
+    // sub rsp, 48; mov rdi, rsp; xor eax, eax; mov ecx, 6; rep stosq
+    CODEGEN_X64_EMIT(gen, 0x48, 0x83, 0xEC, 0x30);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x89, 0xE7);
+    CODEGEN_X64_EMIT(gen, 0x31, 0xC0);
+    CODEGEN_X64_EMIT(gen, 0xB9, 0x06, 0x00, 0x00, 0x00);
+    CODEGEN_X64_EMIT(gen, 0xF3, 0x48, 0xAB);
+
+    // mov rsi, rbx; lea rdx, [r14 + tape_bytes]
+    CODEGEN_X64_EMIT(gen, 0x48, 0x89, 0xDE);
+    CODEGEN_X64_EMIT(gen, 0x49, 0x8D, 0x96);
+    codegen_x64_emit_u32(gen, gen->tape_bytes);
+
+    // cells_left; cmp rax, 2; jb error
+    codegen_x64_emit_cells_left(gen);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x83, 0xF8, 0x02);
+    codegen_x64_emit_jump_error(gen, 0x82);
+
+    // load r8d, [rsi + size]; cmp r8d, 6; ja error
+    codegen_x64_emit_load_cell(gen, r8, rsi, size);
+    CODEGEN_X64_EMIT(gen, 0x41, 0x83, 0xF8, 0x06);
+    codegen_x64_emit_jump_error(gen, 0x87);
+
+    // add rsi, 2 * size; xor r9d, r9d
+    CODEGEN_X64_EMIT(gen, 0x48, 0x83, 0xC6, 2 * size);
+    CODEGEN_X64_EMIT(gen, 0x45, 0x31, 0xC9);
+
+    // arg: cmp r9d, r8d; jae call
+    int32_t arg = gen->code_len;
+    CODEGEN_X64_EMIT(gen, 0x45, 0x39, 0xC1);
+    int32_t call = codegen_x64_emit_jump8(gen, 0x73);
+
+    // cells_left; cmp rax, 2; jb error
+    codegen_x64_emit_cells_left(gen);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x83, 0xF8, 0x02);
+    codegen_x64_emit_jump_error(gen, 0x82);
+
+    // load r10d, [rsi]; load ecx, [rsi + size]; add rsi, 2 * size
+    codegen_x64_emit_load_cell(gen, r10, rsi, 0);
+    codegen_x64_emit_load_cell(gen, rcx, rsi, size);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x83, 0xC6, 2 * size);
+
+    // cells_left; cmp rax, rcx; jb error
+    codegen_x64_emit_cells_left(gen);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x39, 0xC8);
+    codegen_x64_emit_jump_error(gen, 0x82);
+
+    // test r10d, r10d; jnz pointer; xor eax, eax
+    CODEGEN_X64_EMIT(gen, 0x45, 0x85, 0xD2);
+    int32_t pointer = codegen_x64_emit_jump8(gen, 0x75);
+    CODEGEN_X64_EMIT(gen, 0x31, 0xC0);
+
+    // value: jrcxz store; shl rax, cell_bits; load r11d, [rsi]; or rax, r11;
+    // add rsi, size; dec ecx; jmp value
+    int32_t value = gen->code_len;
+    int32_t store = codegen_x64_emit_jump8(gen, 0xE3);
+    CODEGEN_X64_EMIT(gen, 0x48, 0xC1, 0xE0, 8 * size);
+    codegen_x64_emit_load_cell(gen, r11, rsi, 0);
+    CODEGEN_X64_EMIT(gen, 0x4C, 0x09, 0xD8);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x83, 0xC6, size);
+    CODEGEN_X64_EMIT(gen, 0xFF, 0xC9);
+    codegen_x64_emit_jump8_back(gen, 0xEB, value);
+
+    // pointer: cmp r10d, 1; jne error; mov rax, rsi; lea rsi, [rsi + rcx * size]
+    codegen_x64_place_label8(gen, pointer);
+    CODEGEN_X64_EMIT(gen, 0x41, 0x83, 0xFA, 0x01);
+    codegen_x64_emit_jump_error(gen, 0x85);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x89, 0xF0);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x8D, 0x34, (codegen_x64_cell_shift(gen) << 6) | 0x0E);
+
+    // store: mov [rsp + r9 * 8], rax; inc r9d; jmp arg
+    codegen_x64_place_label8(gen, store);
+    CODEGEN_X64_EMIT(gen, 0x4A, 0x89, 0x04, 0xCC);
+    CODEGEN_X64_EMIT(gen, 0x41, 0xFF, 0xC1);
+    codegen_x64_emit_jump8_back(gen, 0xEB, arg);
+
+    // call: load eax, [rbx]; load rdi, rsi, rdx, r10, r8, r9
+    codegen_x64_place_label8(gen, call);
+    codegen_x64_emit_load_cell(gen, rax, rbx, 0);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x8B, 0x3C, 0x24);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x8B, 0x74, 0x24, 0x08);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x8B, 0x54, 0x24, 0x10);
+    CODEGEN_X64_EMIT(gen, 0x4C, 0x8B, 0x54, 0x24, 0x18);
+    CODEGEN_X64_EMIT(gen, 0x4C, 0x8B, 0x44, 0x24, 0x20);
+    CODEGEN_X64_EMIT(gen, 0x4C, 0x8B, 0x4C, 0x24, 0x28);
+
+    // syscall; mov [rbx], al/ax/eax; add rsp, 48; ret
+    CODEGEN_X64_EMIT(gen, 0x0F, 0x05);
+    codegen_x64_emit_store_cell(gen, 0);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x83, 0xC4, 0x30);
+    CODEGEN_X64_EMIT(gen, 0xC3);
+}
+
+static void
+codegen_x64_emit_sys_call(struct codegen_x64 *gen)
+{
+    if (gen->target == CODEGEN_X64_TARGET_STANDALONE) {
+        // call sys_call
+        CODEGEN_X64_EMIT(gen, 0xE8);
+        codegen_x64_emit_rel32(gen, gen->sys_call_offset);
+        return;
+    }
+
+    // mov rdi, r13; mov rsi, rbx; rdx = tape end
+    CODEGEN_X64_EMIT(gen, 0x4C, 0x89, 0xEF);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x89, 0xDE);
+    codegen_x64_emit_tape_end(gen, 2);
+
+    // call sys_call; test eax, eax; jnz error
+    codegen_x64_emit_helper_call(gen, gen->helpers->sys_call);
+    CODEGEN_X64_EMIT(gen, 0x85, 0xC0);
+    codegen_x64_emit_jump_error(gen, 0x85);
+
+    // The kernel may have written anywhere behind the head.
+    // rcx = tape end; mov r15, rcx
+    codegen_x64_emit_tape_end(gen, 1);
+    CODEGEN_X64_EMIT(gen, 0x49, 0x89, 0xCF);
+}
+
+static void
+codegen_x64_emit_scan(struct codegen_x64 *gen, int32_t stride)
+{
+    if (gen->target == CODEGEN_X64_TARGET_STANDALONE) {
+        // loop: cmp [rbx], 0; je done; add rbx, stride_bytes; jmp loop
+        int32_t loop = gen->code_len;
+        codegen_x64_emit_cmp_cell_zero(gen);
+        int32_t done = codegen_x64_emit_jump8(gen, 0x74);
+        CODEGEN_X64_EMIT(gen, 0x48, 0x81, 0xC3);
+        codegen_x64_emit_u32(gen, codegen_x64_cells(gen, stride));
+        codegen_x64_emit_jump8_back(gen, 0xEB, loop);
+        codegen_x64_place_label8(gen, done);
+        return;
+    }
+
+    // mov rdi, rbx
+    CODEGEN_X64_EMIT(gen, 0x48, 0x89, 0xDF);
+    if (stride > 0) {
+        // rsi = tape end
+        codegen_x64_emit_tape_end(gen, 6);
+    } else {
+        // mov rsi, r14
+        CODEGEN_X64_EMIT(gen, 0x4C, 0x89, 0xF6);
+    }
+    // mov edx, |stride|
+    CODEGEN_X64_EMIT(gen, 0xBA);
+    codegen_x64_emit_u32(gen, stride > 0 ? stride : -stride);
+
+    codegen_x64_emit_helper_call(
+            gen,
+            stride > 0 ? gen->helpers->scan_right : gen->helpers->scan_left);
+
+    // test rax, rax; jz error; mov rbx, rax
+    CODEGEN_X64_EMIT(gen, 0x48, 0x85, 0xC0);
+    codegen_x64_emit_jump_bounds_error(gen, 0x84);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x89, 0xC3);
+    if (stride > 0) {
+        codegen_x64_emit_head_max(gen);
+    }
+}
+
+static void
+codegen_x64_emit_check(struct codegen_x64 *gen, int32_t lo, int32_t hi)
+{
+    // lea rax, [rbx + lo_bytes]; cmp rax, r14; jb error
+    CODEGEN_X64_EMIT(gen, 0x48, 0x8D, 0x83);
+    codegen_x64_emit_u32(gen, codegen_x64_cells(gen, lo));
+    CODEGEN_X64_EMIT(gen, 0x4C, 0x39, 0xF0);
+    codegen_x64_emit_jump_bounds_error(gen, 0x82);
+
+    // lea rax, [rbx + hi_bytes]; rcx = tape end; cmp rax, rcx; jae error
+    CODEGEN_X64_EMIT(gen, 0x48, 0x8D, 0x83);
+    codegen_x64_emit_u32(gen, codegen_x64_cells(gen, hi));
+    codegen_x64_emit_tape_end(gen, 1);
+    CODEGEN_X64_EMIT(gen, 0x48, 0x39, 0xC8);
+    codegen_x64_emit_jump_bounds_error(gen, 0x83);
+}
+
+static int8_t
+codegen_x64_emit_instr(struct codegen_x64 *gen, const struct bc_instr *instr)
+{
+    switch (instr->op) {
+        case BC_ADD:
+            // add [rbx + offset], imm
+            codegen_x64_emit_cell_opcode(gen, 0x80, 0x81);
+            codegen_x64_emit_cell_operand(gen, 0, codegen_x64_cells(gen, instr->offset));
+            codegen_x64_emit_cell_imm(gen, instr->arg);
+            break;
+
+        case BC_MOVE:
+            // add rbx, imm32
+            CODEGEN_X64_EMIT(gen, 0x48, 0x81, 0xC3);
+            codegen_x64_emit_u32(gen, codegen_x64_cells(gen, instr->arg));
+            if (instr->arg > 0) {
+                codegen_x64_emit_head_max(gen);
+            }
+            break;
+
+        case BC_SELECT:
+            // add r12d, imm32
+            CODEGEN_X64_EMIT(gen, 0x41, 0x81, 0xC4);
+            codegen_x64_emit_u32(gen, instr->arg);
+            break;
+
+        case BC_JZ:
+            codegen_x64_emit_cmp_cell_zero(gen);
+            CODEGEN_X64_EMIT(gen, 0x0F, 0x84);
+            codegen_x64_emit_rel32_pc(gen, instr->arg);
+            break;
+
+        case BC_JNZ:
+            codegen_x64_emit_cmp_cell_zero(gen);
+            CODEGEN_X64_EMIT(gen, 0x0F, 0x85);
+            codegen_x64_emit_rel32_pc(gen, instr->arg);
+            break;
+
+        case BC_INPUT:
+            codegen_x64_emit_input(gen, instr->offset);
+            break;
+
+        case BC_OUTPUT:
+            codegen_x64_emit_output(gen, instr->offset);
+            break;
+
+        case BC_CALL:
+            codegen_x64_emit_dynamic_call(gen);
+            codegen_x64_emit_store_cell(gen, 0);
+            break;
+
+        case BC_RETURN:
+            codegen_x64_emit_epilogue(gen);
+            break;
+
+        case BC_TAIL_CALL:
+            codegen_x64_emit_tail_call(gen);
+            break;
+
+        case BC_SYS_CALL:
+            codegen_x64_emit_sys_call(gen);
+            break;
+
+        case BC_SET:
+            // mov [rbx + offset], imm
+            codegen_x64_emit_cell_opcode(gen, 0xC6, 0xC7);
+            codegen_x64_emit_cell_operand(gen, 0, codegen_x64_cells(gen, instr->offset));
+            codegen_x64_emit_cell_imm(gen, instr->arg);
+            break;
+
+        case BC_MUL:
+            // load eax, [rbx]; imul eax, eax, imm32; add [rbx + offset], al/ax/eax
+            codegen_x64_emit_load_cell(gen, 0, 3, 0);
+            CODEGEN_X64_EMIT(gen, 0x69, 0xC0);
+            codegen_x64_emit_u32(gen, instr->arg);
+            codegen_x64_emit_cell_opcode(gen, 0x00, 0x01);
+            codegen_x64_emit_cell_operand(gen, 0, codegen_x64_cells(gen, instr->offset));
+            break;
+
+        case BC_SCAN:
+            codegen_x64_emit_scan(gen, instr->arg);
+            break;
+
+        case BC_CHECK:
+            codegen_x64_emit_check(gen, instr->arg, instr->offset);
+            break;
+
+        case BC_CALL_DIRECT:
+            // call func
+            CODEGEN_X64_EMIT(gen, 0xE8);
+            codegen_x64_emit_rel32_func(gen, instr->arg);
+            codegen_x64_emit_store_cell(gen, 0);
+            break;
+
+        case BC_TAIL_CALL_DIRECT:
+            codegen_x64_emit_direct_tail_call(gen, instr->arg);
+            break;
+
+        case BC_ADD_VEC:
+            codegen_x64_emit_add_vec(gen, instr->offset, &gen->vecs[instr->arg]);
+            break;
+
+        default:
+            return -1;
+            break;
+    }
+
+    return 0;
+}
+
+struct codegen_x64_loop {
+    int32_t start;
+    int64_t entry; // head displacement at the loop start
+    int64_t max;   // furthest displacement right of entry in the loop
+    int8_t  balanced;
+};
+
+// Sets bounds[pc] of every loop start to the furthest the head gets right of
+// where it was at the start, if the loop leaves the head there after every
+// iteration, -1 otherwise. The head of such a loop only has to be tracked
+// once before it.
+static int8_t
+codegen_x64_measure_loops(const struct bc_func *func, int32_t *bounds)
+{
+    struct codegen_x64_loop *loops = malloc((func->code_len + 1) * sizeof(*loops));
+    if (!loops) {
+        return -1;
+    }
+
+    int32_t loops_num = 0;
+    int64_t disp = 0;
+
+    for (int32_t pc = 0; pc < func->code_len; pc++) {
+        const struct bc_instr *instr = &func->code[pc];
+        struct codegen_x64_loop *top = loops_num > 0 ? &loops[loops_num - 1] : NULL;
+
+        bounds[pc] = -1;
+
+        switch (instr->op) {
+            case BC_MOVE:
+                disp += instr->arg;
+                if (top && disp - top->entry > top->max) {
+                    top->max = disp - top->entry;
+                }
+                break;
+
+            case BC_SCAN:
+                if (top) {
+                    top->balanced = 0;
+                }
+                break;
+
+            case BC_JZ:
+                loops[loops_num++] = (struct codegen_x64_loop) {pc, disp, 0, 1};
+                break;
+
+            case BC_JNZ:
+            {
+                if (!top) {
+                    break;
+                }
+                struct codegen_x64_loop loop = *top;
+                loops_num--;
+
+                loop.balanced = loop.balanced && disp == loop.entry && loop.max <= INT32_MAX;
+                bounds[loop.start] = loop.balanced ? loop.max : -1;
+
+                if (loops_num > 0) {
+                    struct codegen_x64_loop *outer = &loops[loops_num - 1];
+                    outer->balanced = outer->balanced && loop.balanced;
+                    if (loop.entry - outer->entry + loop.max > outer->max) {
+                        outer->max = loop.entry - outer->entry + loop.max;
+                    }
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    free(loops);
+
+    return 0;
+}
+
+static int8_t
+codegen_x64_compile_func(struct codegen_x64 *gen, const struct bc_func *func, int32_t index)
+{
+    gen->pc_offsets = calloc(func->code_len + 1, sizeof(*gen->pc_offsets));
+    if (!gen->pc_offsets) {
+        return -1;
+    }
+    gen->fixups_num = 0;
+
+    int32_t *bounds = calloc(func->code_len + 1, sizeof(*bounds));
+    if (!bounds || codegen_x64_measure_loops(func, bounds)) {
+        free(bounds);
+        return -1;
+    }
+
+    codegen_x64_emit_prologue(gen, index);
+
+    // Head moves inside a loop measured before are not tracked.
+    int32_t untracked_end = 0;
+
+    for (int32_t pc = 0; pc < func->code_len; pc++) {
+        gen->pc_offsets[pc] = gen->code_len;
+
+        const struct bc_instr *instr = &func->code[pc];
+        if (pc >= untracked_end && instr->op == BC_JZ && bounds[pc] >= 0) {
+            codegen_x64_emit_head_bound(gen, bounds[pc]);
+            untracked_end = instr->arg;
+        }
+        gen->head_tracked = pc >= untracked_end;
+
+        int8_t err = codegen_x64_emit_instr(gen, instr);
+        if (err) {
+            free(bounds);
+            free(gen->pc_offsets);
+            gen->pc_offsets = NULL;
+            return -1;
+        }
+    }
+    free(bounds);
+    gen->pc_offsets[func->code_len] = gen->code_len;
+
+    for (int32_t i = 0; i < gen->fixups_num; i++) {
+        struct codegen_x64_fixup *fixup = &gen->fixups[i];
+        int32_t target = gen->pc_offsets[fixup->target];
+
+        codegen_x64_patch_u32(gen, fixup->pos, target - (fixup->pos + 4));
+    }
+
+    free(gen->pc_offsets);
+    gen->pc_offsets = NULL;
+
+    return gen->err ? -1 : 0;
+}
+
+static void
+codegen_x64_emit_table(struct codegen_x64 *gen)
+{
+    while (gen->code_len % sizeof(int32_t)) {
+        // int3
+        CODEGEN_X64_EMIT(gen, 0xCC);
+    }
+
+    gen->table_offset = gen->code_len;
+    for (int32_t i = 0; i < gen->funcs_num; i++) {
+        codegen_x64_emit_u32(gen, gen->func_offsets[i] - gen->table_offset);
+    }
+
+    for (int32_t i = 0; i < gen->table_fixups_num; i++) {
+        int32_t pos = gen->table_fixups[i];
+
+        codegen_x64_patch_u32(gen, pos, gen->table_offset - (pos + 4));
+    }
+}
+
+static int8_t
+codegen_x64_link_funcs(struct codegen_x64 *gen)
+{
+    for (int32_t i = 0; i < gen->func_fixups_num; i++) {
+        struct codegen_x64_fixup *fixup = &gen->func_fixups[i];
+        if (fixup->target < 0 || fixup->target >= gen->funcs_num) {
+            return -1;
+        }
+
+        int32_t target = gen->func_offsets[fixup->target];
+        codegen_x64_patch_u32(gen, fixup->pos, target - (fixup->pos + 4));
+    }
+
+    return 0;
+}
+
+// The JIT code runs where it is generated, so it may use AVX2 if the host
+// has it. Standalone executables stick to SSE2, which every x86-64 CPU has.
+static int8_t
+codegen_x64_host_has_avx2(void)
+{
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+int8_t
+codegen_x64_init(
+        struct codegen_x64               *gen,
+        enum codegen_x64_target           target,
+        const struct codegen_x64_helpers *helpers)
+{
+    if (!gen) {
+        return -1;
+    }
+    if (target == CODEGEN_X64_TARGET_JIT && !helpers) {
+        return -1;
+    }
+
+    memset(gen, 0, sizeof(*gen));
+    gen->target = target;
+    gen->helpers = helpers;
+    gen->avx2 = target == CODEGEN_X64_TARGET_JIT && codegen_x64_host_has_avx2();
+
+    const int32_t default_code_len = 4096;
+
+    gen->code = malloc(default_code_len);
+    if (!gen->code) {
+        return -1;
+    }
+    gen->code_max_len = default_code_len;
+
+    return 0;
+}
+
+void
+codegen_x64_free(struct codegen_x64 *gen)
+{
+    if (!gen) {
+        return;
+    }
+
+    free(gen->code);
+    free(gen->func_offsets);
+    free(gen->pc_offsets);
+    free(gen->fixups);
+    free(gen->table_fixups);
+    free(gen->func_fixups);
+
+    memset(gen, 0, sizeof(*gen));
+}
+
+int8_t
+codegen_x64_compile(struct codegen_x64 *gen, struct bc_program *program)
+{
+    if (!gen || !program || !gen->code) {
+        return -1;
+    }
+    if (program->cell_size != 1 && program->cell_size != 2 && program->cell_size != 4) {
+        return -1;
+    }
+
+    gen->cell_size = program->cell_size;
+    gen->tape_bytes = CODEGEN_X64_TAPE_SIZE * program->cell_size;
+    gen->vecs = program->vecs;
+    gen->funcs_num = program->funcs_num;
+    gen->func_offsets = calloc(program->funcs_num + 1, sizeof(*gen->func_offsets));
+    if (!gen->func_offsets) {
+        return -1;
+    }
+
+    if (gen->target == CODEGEN_X64_TARGET_STANDALONE) {
+        codegen_x64_emit_flush_routine(gen);
+    }
+    codegen_x64_emit_error(gen);
+    if (gen->target == CODEGEN_X64_TARGET_STANDALONE) {
+        codegen_x64_emit_sys_call_routine(gen);
+    }
+    codegen_x64_emit_entry(gen);
+
+    for (int32_t i = 0; i < program->funcs_num; i++) {
+        gen->func_offsets[i] = gen->code_len;
+
+        int8_t err = codegen_x64_compile_func(gen, &program->funcs[i], i);
+        if (err) {
+            return -1;
+        }
+    }
+
+    codegen_x64_emit_table(gen);
+
+    int8_t err = codegen_x64_link_funcs(gen);
+    if (err) {
+        return -1;
+    }
+
+    return gen->err ? -1 : 0;
+}
\ No newline at end of file
@@ -1,18 +1,69 @@
 /*
- * See interpreter/include/interpreter.h for details.
+ * See compiler/include/compiler.h for details.
  *
  * Zherdev, 2021
  */
 
 #include "compiler.h"
+#include "optimizer.h"
+#include "backend_linux_x64.h"
+#include "backend_c.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const struct backend_ops compiler_backends[COMPILER_BACKENDS_NUM] = {
+    [COMPILER_BACKEND_LINUX_X64] = {
+        .name       = "linux-x64",
+        .back_size  = sizeof(struct backend_linux_x64),
+        .open_file  = backend_linux_x64_open_file,
+        .close_file = backend_linux_x64_close_file,
+        .prepare    = backend_linux_x64_prepare,
+        .write_     = backend_linux_x64_write_,
+        .free       = backend_linux_x64_free,
+    },
+    [COMPILER_BACKEND_C] = {
+        .name       = "c",
+        .back_size  = sizeof(struct backend_c),
+        .open_file  = backend_c_open_file,
+        .close_file = backend_c_close_file,
+        .prepare    = backend_c_prepare,
+        .write_     = backend_c_write_,
+        .free       = backend_c_free,
+    },
+};
 
 int8_t
-compiler_init(struct compiler *compiler, const char *filename)
+compiler_backend_from_str(const char *name, enum compiler_backend *backend)
 {
-    if (!compiler || !filename) {
+    if (!name || !backend) {
         return -1;
     }
 
+    for (int32_t i = 0; i < COMPILER_BACKENDS_NUM; i++) {
+        if (!strcmp(name, compiler_backends[i].name)) {
+            *backend = i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+int8_t
+compiler_init(
+        struct compiler       *compiler,
+        const char            *filename,
+        enum compiler_backend  backend,
+        uint8_t                cell_size)
+{
+    if (!compiler || !filename || backend >= COMPILER_BACKENDS_NUM) {
+        return -1;
+    }
+
+    compiler->backend = backend;
+    compiler->cell_size = cell_size;
+
     int8_t err = parser_init(&compiler->parser, filename);
     if (err) {
         return -1;
@@ -28,6 +79,8 @@ compiler_free(struct compiler *compiler)
         return 0;
     }
 
+    bc_program_free(&compiler->program);
+
     int8_t err = parser_free(&compiler->parser);
     if (err) {
         return -1;
@@ -40,10 +93,10 @@ int8_t
 compiler_read(struct compiler *compiler)
 {
     if (!compiler) {
-        return 0;
+        return -1;
     }
 
-    struct parser  *parser  = &compiler->parser;
+    struct parser *parser = &compiler->parser;
 
     int8_t err = parser_process_file(parser);
     if (err) {
@@ -51,18 +104,52 @@ compiler_read(struct compiler *compiler)
         return -1;
     }
 
-    compiler->sem_root = &parser->analyzer.tree;
+    err = bc_program_init(&compiler->program, &parser->analyzer.tree, compiler->cell_size);
+    if (err) {
+        return -1;
+    }
 
-    return 0;
+    // The C backend gives a tape of as many cells as the x64 one.
+    return bc_program_optimize(&compiler->program, CODEGEN_X64_TAPE_SIZE);
 }
 
 int8_t
-compiler_compile(struct compiler *compiler)
+compiler_compile(struct compiler *compiler, const char *filename)
 {
-    if (!compiler) {
-        return 0;
+    if (!compiler || !filename) {
+        return -1;
+    }
+
+    const struct backend_ops *backend = &compiler_backends[compiler->backend];
+
+    void *back = calloc(1, backend->back_size);
+    if (!back) {
+        return -1;
+    }
+
+    int8_t err = backend->prepare(back, &compiler->program);
+    if (err) {
+        backend->free(back);
+        free(back);
+        return -1;
     }
-    struct runtime *runtime = &interp->runtime;
 
-    return runtime_run(runtime);
+    err = backend->open_file(back, filename);
+    if (err) {
+        backend->free(back);
+        free(back);
+        return -1;
+    }
+
+    err = backend->write_(back);
+
+    int8_t close_err = backend->close_file(back);
+    backend->free(back);
+    free(back);
+
+    if (err || close_err) {
+        return -1;
+    }
+
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+/*
+ * sysfun-bf compiler.
+ *
+ * Zherdev, 2021
+ */
+
+#include "compiler.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int
+main(int argc, char *argv[])
+{
+    enum compiler_backend backend = COMPILER_BACKEND_LINUX_X64;
+    const char *output = "a.out";
+    uint8_t cell_size = 1;
+
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "b:o:w:")) != -1) {
+        switch (opt) {
+            case 'b':
+                if (compiler_backend_from_str(optarg, &backend)) {
+                    return -1;
+                }
+                break;
+
+            case 'o':
+                output = optarg;
+                break;
+
+            case 'w':
+            {
+                char *end = NULL;
+                unsigned long bits = strtoul(optarg, &end, 10);
+                if (end == optarg || *end || bits > UINT32_MAX
+                        || bc_cell_size_from_bits(bits, &cell_size)) {
+                    return -1;
+                }
+                break;
+            }
+
+            default:
+                return -1;
+                break;
+        }
+    }
+
+    if (argc - optind != 1 || strlen(argv[optind]) == 0) {
+        return -1;
+    }
+    const char *filename = argv[optind];
+
+    struct compiler compiler = {0};
+    int8_t err = compiler_init(&compiler, filename, backend, cell_size);
+    if (err) {
+        return -1;
+    }
+
+    err = compiler_read(&compiler);
+    if (err) {
+        return -2;
+    }
+
+    err = compiler_compile(&compiler, output);
+    if (err) {
+        return -3;
+    }
+
+    err = compiler_free(&compiler);
+    if (err) {
+        return -4;
+    }
+
+    return 0;
+}
\ No newline at end of file
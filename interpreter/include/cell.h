@@ -0,0 +1,16 @@
+/*
+ * Zherdev, 2021
+ */
+
+#ifndef CELL_H
+#define CELL_H
+
+// Code that depends on the cell width lives in .inc sources, they are
+// included once per width with CELL defined to the cell type and CELL_BITS
+// to its width. CELL_NAME(name) gives every instance its own name, like
+// name_16, so each width gets fully specialized code.
+#define CELL_NAME_(name, bits) name##_##bits
+#define CELL_NAME__(name, bits) CELL_NAME_(name, bits)
+#define CELL_NAME(name) CELL_NAME__(name, CELL_BITS)
+
+#endif // CELL_H
\ No newline at end of file
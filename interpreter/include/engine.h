@@ -0,0 +1,100 @@
+/*
+ * Zherdev, 2021
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "runtime.h"
+
+#include <stdint.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ENGINE_THREADED_SUPPORTED
+#endif
+
+#if defined(__x86_64__) && defined(__linux__)
+#define ENGINE_JIT_SUPPORTED
+#endif
+
+struct runtime_func {
+    int32_t  index;
+    int32_t  pc;
+    int32_t  head_pos;
+    uint32_t func_pos;
+    uint32_t return_code;
+    void    *buff;       // cells of runtime->frames.cell_size bytes
+
+    // Range of head positions reached, it is zeroed when the tape is reused.
+    int32_t  head_min;
+    int32_t  head_max;
+};
+
+typedef int8_t (*engine_prepare)(struct runtime *runtime);
+typedef int8_t (*engine_run)(struct runtime *runtime, struct runtime_func *func);
+typedef void   (*engine_free)(struct runtime *runtime);
+
+// Runs the function on a new frame until it returns, the engines handle
+// the calls it makes without recursion.
+int8_t
+runtime_func_call(struct runtime *runtime, uint32_t func_pos, uint32_t *return_code);
+
+// Returns a new frame with a clean tape for the function at func_pos, NULL
+// if there is no such function or the depth limit is reached.
+struct runtime_func *
+runtime_frames_push(struct runtime *runtime, uint32_t func_pos);
+
+// Drops the top frame and returns the one below it.
+struct runtime_func *
+runtime_frames_pop(struct runtime *runtime);
+
+int8_t
+runtime_output_flush(struct runtime_output *output);
+
+// Returns the next input byte, EOF is -1 and reads as a cell of all ones.
+int32_t
+runtime_input(struct runtime *runtime);
+
+// Performs the syscall described at cell, end is the end of the tape.
+int8_t
+runtime_sys_call(struct runtime *runtime, void *cell, void *end);
+
+// Called for every '.', so it is inlined into the engines. Only the low byte
+// of a cell is written. A full buffer is written out right away, so a
+// buffer of one byte leaves the output unbuffered.
+static inline int8_t
+runtime_output_put(struct runtime_output *output, uint8_t cell)
+{
+    output->buff[output->len++] = cell;
+
+    if (output->len == output->size && runtime_output_flush(output)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+// Every engine is specialized for each cell width, the width of the program
+// picks the instance once per run.
+int8_t
+engine_switch_run(struct runtime *runtime, struct runtime_func *func);
+
+int8_t
+engine_threaded_prepare(struct runtime *runtime);
+
+int8_t
+engine_threaded_run(struct runtime *runtime, struct runtime_func *func);
+
+void
+engine_threaded_free(struct runtime *runtime);
+
+int8_t
+engine_jit_prepare(struct runtime *runtime);
+
+int8_t
+engine_jit_run(struct runtime *runtime, struct runtime_func *func);
+
+void
+engine_jit_free(struct runtime *runtime);
+
+#endif // ENGINE_H
\ No newline at end of file
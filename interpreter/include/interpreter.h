@@ -11,12 +11,16 @@
 #include <stdint.h>
 
 struct interpreter {
-    struct parser  parser;
-    struct runtime runtime;
+    struct parser          parser;
+    struct runtime         runtime;
+    struct runtime_options options;
 };
 
 int8_t
-interpreter_init(struct interpreter *interp, const char *filename);
+interpreter_init(
+        struct interpreter           *interp,
+        const char                   *filename,
+        const struct runtime_options *options);
 
 int8_t
 interpreter_free(struct interpreter *interp);
@@ -6,16 +6,107 @@
 #define RUNTIME_H
 
 #include "semantics.h"
+#include "bytecode.h"
 
+#include <setjmp.h>
 #include <stdint.h>
 
 #define RUNTIME_FUNC_DEFAULT_STACK_SIZE (10240)
+#define RUNTIME_DEFAULT_OUTPUT_SIZE (65536)
+#define RUNTIME_DEFAULT_MAX_DEPTH (16384)
+#define RUNTIME_DEFAULT_TAPE_SIZE (1 << 20)
+#define RUNTIME_MAX_TAPE_SIZE (1 << 30)
+
+enum runtime_engine {
+    RUNTIME_ENGINE_SWITCH,
+    RUNTIME_ENGINE_THREADED,
+    RUNTIME_ENGINE_JIT,
+
+    RUNTIME_ENGINES_NUM
+};
+
+struct runtime_options {
+    enum runtime_engine engine;
+    uint32_t            output_size; // 0 means unbuffered output
+    uint32_t            max_depth;   // deeper calls are a runtime error
+    uint32_t            tape_size;   // cells a tape may grow to, rounded up to whole pages
+    int8_t              checked;     // bounds checks instead of guard pages
+    uint8_t             cell_size;   // bytes per cell: 1, 2 or 4
+};
+
+// Program output is collected here and written to the fd in batches.
+struct runtime_output {
+    uint8_t *buff;
+    uint32_t len;
+    uint32_t size;
+    int32_t  fd;
+    int8_t   interactive;
+};
+
+struct runtime_func;
+
+// Frames of the active Brainfunctions. The engines push and pop them
+// instead of recursing, every depth owns a slot of a single reserved region:
+// a tape of up to tape_size cells followed by a PROT_NONE guard, the region
+// starts with a guard as well. The beginning of a tape is made accessible
+// when the slot is first used, a fault further in the tape grows it and a
+// fault in a guard is an out of bounds error that jumps to fault_jmp.
+// The guards are wider than the head can get from a cell it accessed, so
+// no checks are needed. In the checked mode the program checks its own
+// accesses instead, see bytecode/include/bounds.h, the whole region is
+// accessible and the guards are just padding the head may rest in. A reused
+// slot only gets the range touched by its previous user zeroed.
+struct runtime_frames {
+    struct runtime_func *stack;
+    uint32_t             depth;
+    uint32_t             max_depth;
+
+    uint8_t             *mem;
+    uint64_t             mem_size;
+    uint64_t             tape_size;  // in cells
+    uint64_t             tape_bytes;
+    uint64_t             guard_size; // in bytes, as everything below
+    uint64_t             page_size;
+    uint64_t            *committed;  // accessible bytes of every tape
+    uint8_t              cell_size;
+    int8_t               checked;
+    int8_t               out_of_bounds; // the run failed on a tape access
+
+    // Cell offsets around the head used by the program.
+    int32_t              offset_min;
+    int32_t              offset_max;
+
+    sigjmp_buf           fault_jmp;
+};
 
 struct runtime {
-    struct sem_node *sem_root;
+    struct runtime_options options;
+    struct bc_program      program;
+    struct runtime_output  output;
+    struct runtime_frames  frames;
+    void                  *engine_data;
 };
 
+void
+runtime_options_init(struct runtime_options *options);
+
+int8_t
+runtime_engine_from_str(const char *name, enum runtime_engine *engine);
+
+int8_t
+runtime_init(
+        struct runtime               *runtime,
+        const struct sem_tree        *sem_tree,
+        const struct runtime_options *options);
+
+void
+runtime_free(struct runtime *runtime);
+
 int8_t
 runtime_run(struct runtime *runtime);
 
+// Describes why the last run failed.
+int8_t
+runtime_err_to_stderr(struct runtime *runtime);
+
 #endif // RUNTIME_H
\ No newline at end of file
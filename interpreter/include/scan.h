@@ -0,0 +1,35 @@
+/*
+ * Zherdev, 2021
+ */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdint.h>
+
+#define SCAN_MAX_VEC_STRIDE (16)
+
+void
+scan_init(void);
+
+// Scans for the nearest zero cell every stride cells, NULL if there is none
+// before end or down to begin. There is one pair per cell width.
+void *
+scan_right_8(void *pos, void *end, int32_t stride);
+
+void *
+scan_left_8(void *pos, void *begin, int32_t stride);
+
+void *
+scan_right_16(void *pos, void *end, int32_t stride);
+
+void *
+scan_left_16(void *pos, void *begin, int32_t stride);
+
+void *
+scan_right_32(void *pos, void *end, int32_t stride);
+
+void *
+scan_left_32(void *pos, void *begin, int32_t stride);
+
+#endif // SCAN_H
\ No newline at end of file
@@ -0,0 +1,40 @@
+/*
+ * Zherdev, 2021
+ */
+
+#ifndef SYS_CALL_H
+#define SYS_CALL_H
+
+#include <stdint.h>
+
+// The Systemf calling convention, the block starts at the current cell:
+//     syscall number, argument count,
+//     then for every argument: type, length in cells, length cells of data.
+// A value argument is read from its cells in big-endian order, every cell
+// being a digit of the cell width, a pointer argument points straight at
+// its cells inside the tape.
+#define SYS_CALL_MAX_ARGS (6)
+
+enum sys_call_arg_type {
+    SYS_CALL_ARG_VALUE,
+    SYS_CALL_ARG_POINTER
+};
+
+// A decoded block, end is past its last cell.
+struct sys_call {
+    long     number;
+    long     args[SYS_CALL_MAX_ARGS];
+    uint8_t *end;
+};
+
+// Decodes the block of cell_size wide cells at cell, which must not cross
+// end.
+int8_t
+sys_call_decode(struct sys_call *call, void *cell, void *end, uint8_t cell_size);
+
+// Performs the syscall and writes the result truncated to the cell width
+// back to cell.
+void
+sys_call_exec(const struct sys_call *call, void *cell, uint8_t cell_size);
+
+#endif // SYS_CALL_H
\ No newline at end of file
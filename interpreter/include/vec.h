@@ -0,0 +1,28 @@
+/*
+ * Zherdev, 2021
+ */
+
+#ifndef VEC_H
+#define VEC_H
+
+#include "bytecode.h"
+
+#include <stdint.h>
+
+// Picks the vector kernels for the CPU, AVX2 or SSE2 on x86-64 and plain
+// loops anywhere else.
+void
+vec_init(void);
+
+// Adds the deltas of vec to the cells from cells on. There is one per cell
+// width, the lanes wrap around like the cells do.
+void
+vec_add_8(void *cells, const struct bc_vec *vec);
+
+void
+vec_add_16(void *cells, const struct bc_vec *vec);
+
+void
+vec_add_32(void *cells, const struct bc_vec *vec);
+
+#endif // VEC_H
\ No newline at end of file
@@ -0,0 +1,262 @@
+/*
+ * See interpreter/include/engine.h for details.
+ *
+ * Zherdev, 2021
+ */
+
+#include "engine.h"
+#include "codegen_x64.h"
+#include "scan.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ENGINE_JIT_SUPPORTED
+
+#include <sys/mman.h>
+
+typedef int64_t (*engine_jit_entry)(struct codegen_x64_ctx *ctx, int32_t index);
+
+// Room below the deepest Brainfunction for the helpers and the libc.
+#define ENGINE_JIT_HELPERS_STACK_SIZE (65536)
+
+struct engine_jit {
+    uint8_t          *mem;
+    size_t            mem_size;
+    engine_jit_entry  entry;
+
+    uint8_t          *stack;
+    size_t            stack_size;
+};
+
+static int32_t
+engine_jit_input(struct codegen_x64_ctx *ctx)
+{
+    struct runtime *runtime = ctx->data;
+    return runtime_input(runtime);
+}
+
+static int32_t
+engine_jit_output(struct codegen_x64_ctx *ctx, uint8_t cell)
+{
+    struct runtime *runtime = ctx->data;
+    return runtime_output_put(&runtime->output, cell);
+}
+
+static int32_t
+engine_jit_sys_call(struct codegen_x64_ctx *ctx, void *cell, void *end)
+{
+    struct runtime *runtime = ctx->data;
+    return runtime_sys_call(runtime, cell, end);
+}
+
+static void *
+engine_jit_push(struct codegen_x64_ctx *ctx, int32_t index)
+{
+    struct runtime *runtime = ctx->data;
+    struct runtime_func *func = runtime_frames_push(runtime, index);
+    return func ? func->buff : NULL;
+}
+
+// The generated code only tracks how far right the head got, it can not
+// access cells left of the tape without an error.
+static void
+engine_jit_pop(struct codegen_x64_ctx *ctx, void *head_max)
+{
+    struct runtime *runtime = ctx->data;
+    struct runtime_frames *frames = &runtime->frames;
+    struct runtime_func *func = &frames->stack[frames->depth - 1];
+
+    func->head_max = ((uint8_t *) head_max - (uint8_t *) func->buff) / frames->cell_size;
+    runtime_frames_pop(runtime);
+}
+
+// One set per cell width, only the scans depend on it.
+static const struct codegen_x64_helpers engine_jit_helpers_8 = {
+    .input      = engine_jit_input,
+    .output     = engine_jit_output,
+    .sys_call   = engine_jit_sys_call,
+    .scan_right = scan_right_8,
+    .scan_left  = scan_left_8,
+    .push       = engine_jit_push,
+    .pop        = engine_jit_pop,
+};
+
+static const struct codegen_x64_helpers engine_jit_helpers_16 = {
+    .input      = engine_jit_input,
+    .output     = engine_jit_output,
+    .sys_call   = engine_jit_sys_call,
+    .scan_right = scan_right_16,
+    .scan_left  = scan_left_16,
+    .push       = engine_jit_push,
+    .pop        = engine_jit_pop,
+};
+
+static const struct codegen_x64_helpers engine_jit_helpers_32 = {
+    .input      = engine_jit_input,
+    .output     = engine_jit_output,
+    .sys_call   = engine_jit_sys_call,
+    .scan_right = scan_right_32,
+    .scan_left  = scan_left_32,
+    .push       = engine_jit_push,
+    .pop        = engine_jit_pop,
+};
+
+int8_t
+engine_jit_prepare(struct runtime *runtime)
+{
+    if (!runtime) {
+        return -1;
+    }
+
+    const struct codegen_x64_helpers *helpers = NULL;
+    switch (runtime->program.cell_size) {
+        case 1:
+            helpers = &engine_jit_helpers_8;
+            break;
+        case 2:
+            helpers = &engine_jit_helpers_16;
+            break;
+        case 4:
+            helpers = &engine_jit_helpers_32;
+            break;
+        default:
+            return -1;
+    }
+
+    struct codegen_x64 gen = {0};
+    int8_t err = codegen_x64_init(&gen, CODEGEN_X64_TARGET_JIT, helpers);
+    if (err) {
+        return -1;
+    }
+
+    err = codegen_x64_compile(&gen, &runtime->program);
+    if (err) {
+        codegen_x64_free(&gen);
+        return -1;
+    }
+
+    struct engine_jit *jit = calloc(1, sizeof(*jit));
+    if (!jit) {
+        codegen_x64_free(&gen);
+        return -1;
+    }
+    runtime->engine_data = jit;
+
+    jit->mem_size = gen.code_len;
+    jit->mem = mmap(
+            NULL, jit->mem_size,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS,
+            -1, 0);
+    if (jit->mem == MAP_FAILED) {
+        jit->mem = NULL;
+        codegen_x64_free(&gen);
+        return -1;
+    }
+
+    memcpy(jit->mem, gen.code, gen.code_len);
+    jit->entry = (engine_jit_entry) (jit->mem + gen.entry_offset);
+    codegen_x64_free(&gen);
+
+    if (mprotect(jit->mem, jit->mem_size, PROT_READ | PROT_EXEC)) {
+        return -1;
+    }
+
+    // The kernel backs the stack lazily, deep recursion only costs the
+    // frames in use.
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+#ifdef MAP_STACK
+    flags |= MAP_STACK;
+#endif
+
+    jit->stack_size = ENGINE_JIT_HELPERS_STACK_SIZE
+            + (size_t) runtime->options.max_depth * CODEGEN_X64_FRAME_SIZE
+            + 16;
+    jit->stack = mmap(NULL, jit->stack_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (jit->stack == MAP_FAILED) {
+        jit->stack = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int8_t
+engine_jit_run(struct runtime *runtime, struct runtime_func *func)
+{
+    if (!runtime || !func || !runtime->engine_data) {
+        return -1;
+    }
+
+    struct engine_jit *jit = runtime->engine_data;
+    struct codegen_x64_ctx ctx = {0};
+    ctx.stack_top = (uintptr_t) (jit->stack + jit->stack_size);
+    ctx.stack_limit = (uintptr_t) jit->stack
+            + ENGINE_JIT_HELPERS_STACK_SIZE
+            + CODEGEN_X64_FRAME_SIZE;
+    ctx.tape_bytes = runtime->frames.tape_bytes;
+    ctx.data = runtime;
+
+    // Every function of the generated code pushes a frame of its own.
+    runtime_frames_pop(runtime);
+
+    int64_t res = jit->entry(&ctx, func->index);
+    if (res < 0) {
+        if (ctx.out_of_bounds) {
+            runtime->frames.out_of_bounds = 1;
+        }
+        return -1;
+    }
+
+    func->return_code = res;
+
+    return 0;
+}
+
+void
+engine_jit_free(struct runtime *runtime)
+{
+    if (!runtime || !runtime->engine_data) {
+        return;
+    }
+
+    struct engine_jit *jit = runtime->engine_data;
+    if (jit->mem) {
+        munmap(jit->mem, jit->mem_size);
+    }
+    if (jit->stack) {
+        munmap(jit->stack, jit->stack_size);
+    }
+    free(jit);
+
+    runtime->engine_data = NULL;
+}
+
+#else // ENGINE_JIT_SUPPORTED
+
+int8_t
+engine_jit_prepare(struct runtime *runtime)
+{
+    (void) runtime;
+    return -1;
+}
+
+int8_t
+engine_jit_run(struct runtime *runtime, struct runtime_func *func)
+{
+    (void) runtime;
+    (void) func;
+    return -1;
+}
+
+void
+engine_jit_free(struct runtime *runtime)
+{
+    (void) runtime;
+}
+
+#endif // ENGINE_JIT_SUPPORTED
\ No newline at end of file
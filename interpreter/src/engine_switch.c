@@ -0,0 +1,47 @@
+/*
+ * See interpreter/include/engine.h for details.
+ *
+ * Zherdev, 2021
+ */
+
+#include "engine.h"
+#include "scan.h"
+#include "vec.h"
+#include "cell.h"
+
+#define CELL uint8_t
+#define CELL_BITS 8
+#include "engine_switch.inc"
+#undef CELL_BITS
+#undef CELL
+
+#define CELL uint16_t
+#define CELL_BITS 16
+#include "engine_switch.inc"
+#undef CELL_BITS
+#undef CELL
+
+#define CELL uint32_t
+#define CELL_BITS 32
+#include "engine_switch.inc"
+#undef CELL_BITS
+#undef CELL
+
+int8_t
+engine_switch_run(struct runtime *runtime, struct runtime_func *func)
+{
+    if (!runtime || !func) {
+        return -1;
+    }
+
+    switch (runtime->frames.cell_size) {
+        case 1:
+            return engine_switch_exec_8(runtime, func);
+        case 2:
+            return engine_switch_exec_16(runtime, func);
+        case 4:
+            return engine_switch_exec_32(runtime, func);
+        default:
+            return -1;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,232 @@
+/*
+ * See interpreter/include/engine.h for details.
+ *
+ * Zherdev, 2021
+ */
+
+#include "engine.h"
+#include "scan.h"
+#include "vec.h"
+#include "cell.h"
+
+#include <stdlib.h>
+
+#ifdef ENGINE_THREADED_SUPPORTED
+
+struct engine_threaded_instr {
+    const void *handler;
+    int32_t     arg;
+    int32_t     offset;
+};
+
+typedef int8_t (*engine_threaded_exec)(
+        struct runtime                      *runtime,
+        struct runtime_func                 *func,
+        struct engine_threaded_instr *const *funcs);
+
+struct engine_threaded_code {
+    struct engine_threaded_instr **funcs;
+    int32_t                        funcs_num;
+    engine_threaded_exec           exec;
+};
+
+enum engine_threaded_handler {
+    ENGINE_THREADED_ADD_CELL = BC_OPCODES_NUM,
+    ENGINE_THREADED_SET_CELL,
+    ENGINE_THREADED_MUL_CELL,
+    ENGINE_THREADED_MOVE_CALL,
+
+    ENGINE_THREADED_HANDLERS_NUM
+};
+
+#define CELL uint8_t
+#define CELL_BITS 8
+#include "engine_threaded.inc"
+#undef CELL_BITS
+#undef CELL
+
+#define CELL uint16_t
+#define CELL_BITS 16
+#include "engine_threaded.inc"
+#undef CELL_BITS
+#undef CELL
+
+#define CELL uint32_t
+#define CELL_BITS 32
+#include "engine_threaded.inc"
+#undef CELL_BITS
+#undef CELL
+
+// A call overwrites the cell under the head with its return code once the
+// callee has run. A move to that cell does not load it, so a head out of
+// the tape fails only after the callee, as on the other engines.
+static int8_t
+engine_threaded_moves_to_call(const struct bc_func *func, int32_t pc)
+{
+    pc++;
+    while (pc < func->code_len && func->code[pc].op == BC_SELECT) {
+        pc++;
+    }
+    if (pc == func->code_len) {
+        return 0;
+    }
+
+    uint8_t op = func->code[pc].op;
+    return op == BC_CALL || op == BC_CALL_DIRECT || op == BC_TAIL_CALL || op == BC_TAIL_CALL_DIRECT;
+}
+
+static int32_t
+engine_threaded_handler_index(const struct bc_func *func, int32_t pc)
+{
+    const struct bc_instr *instr = &func->code[pc];
+
+    if (instr->op == BC_MOVE && engine_threaded_moves_to_call(func, pc)) {
+        return ENGINE_THREADED_MOVE_CALL;
+    }
+    if (instr->op == BC_ADD && instr->offset == 0) {
+        return ENGINE_THREADED_ADD_CELL;
+    }
+    if (instr->op == BC_SET && instr->offset == 0) {
+        return ENGINE_THREADED_SET_CELL;
+    }
+    if (instr->op == BC_MUL && instr->offset == 0) {
+        return ENGINE_THREADED_MUL_CELL;
+    }
+
+    return instr->op;
+}
+
+static struct engine_threaded_instr *
+engine_threaded_translate(const struct bc_func *bc_func, const void *const *handlers)
+{
+    struct engine_threaded_instr *code = calloc(bc_func->code_len, sizeof(*code));
+    if (!code) {
+        return NULL;
+    }
+
+    for (int32_t pc = 0; pc < bc_func->code_len; pc++) {
+        const struct bc_instr *instr = &bc_func->code[pc];
+
+        if (instr->op >= BC_OPCODES_NUM) {
+            free(code);
+            return NULL;
+        }
+
+        code[pc].handler = handlers[engine_threaded_handler_index(bc_func, pc)];
+        code[pc].arg = instr->arg;
+        code[pc].offset = instr->offset;
+    }
+
+    return code;
+}
+
+int8_t
+engine_threaded_prepare(struct runtime *runtime)
+{
+    if (!runtime) {
+        return -1;
+    }
+
+    struct bc_program *program = &runtime->program;
+
+    struct engine_threaded_code *threaded = calloc(1, sizeof(*threaded));
+    if (!threaded) {
+        return -1;
+    }
+    runtime->engine_data = threaded;
+
+    const void *const *handlers = NULL;
+    switch (program->cell_size) {
+        case 1:
+            threaded->exec = engine_threaded_exec_8;
+            threaded->exec(NULL, NULL, NULL);
+            handlers = engine_threaded_handlers_8;
+            break;
+        case 2:
+            threaded->exec = engine_threaded_exec_16;
+            threaded->exec(NULL, NULL, NULL);
+            handlers = engine_threaded_handlers_16;
+            break;
+        case 4:
+            threaded->exec = engine_threaded_exec_32;
+            threaded->exec(NULL, NULL, NULL);
+            handlers = engine_threaded_handlers_32;
+            break;
+        default:
+            return -1;
+    }
+
+    if (program->funcs_num == 0) {
+        return 0;
+    }
+
+    threaded->funcs = calloc(program->funcs_num, sizeof(*threaded->funcs));
+    if (!threaded->funcs) {
+        return -1;
+    }
+    threaded->funcs_num = program->funcs_num;
+
+    for (int32_t i = 0; i < program->funcs_num; i++) {
+        threaded->funcs[i] = engine_threaded_translate(&program->funcs[i], handlers);
+        if (!threaded->funcs[i]) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int8_t
+engine_threaded_run(struct runtime *runtime, struct runtime_func *func)
+{
+    if (!runtime || !func || !runtime->engine_data) {
+        return -1;
+    }
+
+    struct engine_threaded_code *threaded = runtime->engine_data;
+
+    return threaded->exec(runtime, func, threaded->funcs);
+}
+
+void
+engine_threaded_free(struct runtime *runtime)
+{
+    if (!runtime || !runtime->engine_data) {
+        return;
+    }
+
+    struct engine_threaded_code *threaded = runtime->engine_data;
+
+    for (int32_t i = 0; i < threaded->funcs_num; i++) {
+        free(threaded->funcs[i]);
+    }
+    free(threaded->funcs);
+    free(threaded);
+
+    runtime->engine_data = NULL;
+}
+
+#else // ENGINE_THREADED_SUPPORTED
+
+int8_t
+engine_threaded_prepare(struct runtime *runtime)
+{
+    (void) runtime;
+    return -1;
+}
+
+int8_t
+engine_threaded_run(struct runtime *runtime, struct runtime_func *func)
+{
+    (void) runtime;
+    (void) func;
+    return -1;
+}
+
+void
+engine_threaded_free(struct runtime *runtime)
+{
+    (void) runtime;
+}
+
+#endif // ENGINE_THREADED_SUPPORTED
\ No newline at end of file
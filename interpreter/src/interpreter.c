@@ -7,12 +7,17 @@
 #include "interpreter.h"
 
 int8_t
-interpreter_init(struct interpreter *interp, const char *filename)
+interpreter_init(
+        struct interpreter           *interp,
+        const char                   *filename,
+        const struct runtime_options *options)
 {
-    if (!interp || !filename) {
+    if (!interp || !filename || !options) {
         return -1;
     }
 
+    interp->options = *options;
+
     int8_t err = parser_init(&interp->parser, filename);
     if (err) {
         return -1;
@@ -28,6 +33,8 @@ interpreter_free(struct interpreter *interp)
         return 0;
     }
 
+    runtime_free(&interp->runtime);
+
     int8_t err = parser_free(&interp->parser);
     if (err) {
         return -1;
@@ -52,7 +59,10 @@ interpreter_read(struct interpreter *interp)
         return -1;
     }
 
-    runtime->sem_root = &parser->analyzer.tree;
+    err = runtime_init(runtime, &parser->analyzer.tree, &interp->options);
+    if (err) {
+        return -1;
+    }
 
     return 0;
 }
@@ -65,5 +75,11 @@ interpreter_run(struct interpreter *interp)
     }
     struct runtime *runtime = &interp->runtime;
 
-    return runtime_run(runtime);
+    int8_t err = runtime_run(runtime);
+    if (err) {
+        runtime_err_to_stderr(runtime);
+        return -1;
+    }
+
+    return 0;
 }
\ No newline at end of file
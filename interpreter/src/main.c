@@ -7,18 +7,86 @@
 #include "interpreter.h"
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 int
 main(int argc, char *argv[])
 {
-    if (argc != 2 || strlen(argv[1]) == 0) {
+    struct runtime_options options = {0};
+    runtime_options_init(&options);
+
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "e:b:d:t:cw:")) != -1) {
+        switch (opt) {
+            case 'e':
+                if (runtime_engine_from_str(optarg, &options.engine)) {
+                    return -1;
+                }
+                break;
+
+            case 'b':
+            {
+                char *end = NULL;
+                unsigned long size = strtoul(optarg, &end, 10);
+                if (end == optarg || *end || size > UINT32_MAX) {
+                    return -1;
+                }
+                options.output_size = size;
+                break;
+            }
+
+            case 'd':
+            {
+                char *end = NULL;
+                unsigned long depth = strtoul(optarg, &end, 10);
+                if (end == optarg || *end || depth == 0 || depth > UINT32_MAX) {
+                    return -1;
+                }
+                options.max_depth = depth;
+                break;
+            }
+
+            case 't':
+            {
+                char *end = NULL;
+                unsigned long size = strtoul(optarg, &end, 10);
+                if (end == optarg || *end || size == 0 || size > RUNTIME_MAX_TAPE_SIZE) {
+                    return -1;
+                }
+                options.tape_size = size;
+                break;
+            }
+
+            case 'c':
+                options.checked = 1;
+                break;
+
+            case 'w':
+            {
+                char *end = NULL;
+                unsigned long bits = strtoul(optarg, &end, 10);
+                if (end == optarg || *end || bits > UINT32_MAX
+                        || bc_cell_size_from_bits(bits, &options.cell_size)) {
+                    return -1;
+                }
+                break;
+            }
+
+            default:
+                return -1;
+                break;
+        }
+    }
+
+    if (argc - optind != 1 || strlen(argv[optind]) == 0) {
         return -1;
     }
-    const char *filename = argv[1];
+    const char *filename = argv[optind];
 
     struct interpreter interp = {0};
-    int8_t err = interpreter_init(&interp, filename);
+    int8_t err = interpreter_init(&interp, filename, &options);
     if (err) {
         return -1;
     }
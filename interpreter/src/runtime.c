@@ -5,207 +5,607 @@
  */
 
 #include "runtime.h"
-
+#include "bounds.h"
+#include "engine.h"
+#include "optimizer.h"
+#include "scan.h"
+#include "sys_call.h"
+#include "vec.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <unistd.h>
-#include <sys/syscall.h>
-#include <sys/types.h>
-
-struct runtime_func {
-    struct sem_node *sem_node;
-    uint32_t head_pos;
-    uint32_t func_pos;
-    uint8_t  done;
-    uint8_t  return_code;
-    uint8_t  buff[RUNTIME_FUNC_DEFAULT_STACK_SIZE];
+
+struct runtime_engine_ops {
+    const char     *name;
+    engine_prepare  prepare;
+    engine_run      run;
+    engine_free     free;
 };
 
-static int8_t
-runtime_func_run(struct runtime_func *func);
+static const struct runtime_engine_ops runtime_engines[RUNTIME_ENGINES_NUM] = {
+    [RUNTIME_ENGINE_SWITCH] = {
+        .name    = "switch",
+        .prepare = NULL,
+        .run     = engine_switch_run,
+        .free    = NULL,
+    },
+    [RUNTIME_ENGINE_THREADED] = {
+        .name    = "threaded",
+        .prepare = engine_threaded_prepare,
+        .run     = engine_threaded_run,
+        .free    = engine_threaded_free,
+    },
+    [RUNTIME_ENGINE_JIT] = {
+        .name    = "jit",
+        .prepare = engine_jit_prepare,
+        .run     = engine_jit_run,
+        .free    = engine_jit_free,
+    },
+};
 
-static int8_t
-runtime_func_run_node(struct runtime_func *func, struct sem_node *node);
+void
+runtime_options_init(struct runtime_options *options)
+{
+    if (!options) {
+        return;
+    }
 
-static struct sem_node *
-runtime_func_get_subfunc_node(struct runtime_func *func)
+#ifdef ENGINE_THREADED_SUPPORTED
+    options->engine = RUNTIME_ENGINE_THREADED;
+#else
+    options->engine = RUNTIME_ENGINE_SWITCH;
+#endif
+    options->output_size = RUNTIME_DEFAULT_OUTPUT_SIZE;
+    options->max_depth = RUNTIME_DEFAULT_MAX_DEPTH;
+    options->tape_size = RUNTIME_DEFAULT_TAPE_SIZE;
+    options->checked = 0;
+    options->cell_size = 1;
+}
+
+int8_t
+runtime_engine_from_str(const char *name, enum runtime_engine *engine)
 {
-    struct sem_node *root = func->sem_node->root;
+    if (!name || !engine) {
+        return -1;
+    }
 
-    if (root->leaves_num <= func->func_pos) {
-        return NULL;
+    for (int32_t i = 0; i < RUNTIME_ENGINES_NUM; i++) {
+        if (!strcmp(name, runtime_engines[i].name)) {
+            *engine = i;
+            return 0;
+        }
     }
 
-    return &root->leaves[func->func_pos];
+    return -1;
 }
 
 static int8_t
-runtime_func_run_action(struct runtime_func *func, enum sem_node_type action)
+runtime_output_init(struct runtime_output *output, uint32_t size, int32_t fd)
 {
-    switch (action) {
-        case SEM_ACTION_INC:
-            func->buff[func->head_pos]++;
-            return 0;
-            break;
+    if (size == 0) {
+        size = 1;
+    }
 
-        case SEM_ACTION_DEC:
-            func->buff[func->head_pos]--;
-            return 0;
-            break;
+    output->buff = malloc(size);
+    if (!output->buff) {
+        return -1;
+    }
 
-        case SEM_ACTION_LEFT:
-            func->head_pos--;
-            return 0;
-            break;
+    output->len = 0;
+    output->size = size;
+    output->fd = fd;
+    output->interactive = isatty(fd);
 
-        case SEM_ACTION_RIGHT:
-            func->head_pos++;
-            return 0;
-            break;
+    return 0;
+}
 
-        case SEM_ACTION_INPUT:
-            func->buff[func->head_pos] = getc(stdin);
-            return 0;
-            break;
+int8_t
+runtime_output_flush(struct runtime_output *output)
+{
+    uint8_t *bytes = output->buff;
+    uint32_t len = output->len;
 
-        case SEM_ACTION_OUTPUT:
-            if (putc(func->buff[func->head_pos], stdout) == EOF) {
-                return -1;
-            }
-            return 0;
-            break;
+    while (len > 0) {
+        ssize_t res = write(output->fd, bytes, len);
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            return -1;
+        }
 
-        case SEM_ACTION_UP:
-            func->func_pos--;
-            return 0;
-            break;
+        bytes += res;
+        len -= res;
+    }
 
-        case SEM_ACTION_DOWN:
-            func->func_pos++;
-            return 0;
-            break;
+    output->len = 0;
 
-        case SEM_ACTION_RETURN:
-            func->done = 1;
-            func->return_code = func->buff[func->head_pos];
-            return 0;
-            break;
+    return 0;
+}
 
-        case SEM_ACTION_FUNC_CALL:
-        {
-            struct runtime_func subfunc = {0};
+static uint64_t
+runtime_round_up(uint64_t value, uint64_t align)
+{
+    return (value + align - 1) / align * align;
+}
 
-            subfunc.sem_node = runtime_func_get_subfunc_node(func);
-            if (!subfunc.sem_node) {
-                return -1;
-            }
+// A tape is made of whole pages, so it gets all cells of its last page.
+static uint32_t
+runtime_tape_size(uint32_t tape_size, uint8_t cell_size)
+{
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+
+    return runtime_round_up((uint64_t) tape_size * cell_size, page_size) / cell_size;
+}
+
+// Between two accesses it runs straight-line code, so it can not get
+// further from an accessed cell than all moves of a function add up to plus
+// the distance between the offsets of the two accesses. A scan step counts
+// as a move of its stride.
+static void
+runtime_frames_measure(struct runtime_frames *frames, const struct bc_program *program)
+{
+    int64_t moves_max = 0;
+
+    frames->offset_min = 0;
+    frames->offset_max = 0;
+
+    for (int32_t i = 0; i < program->funcs_num; i++) {
+        const struct bc_func *func = &program->funcs[i];
+        int64_t moves = 0;
 
-            int8_t err = runtime_func_run(&subfunc);
-            if (err) {
-                return -1;
+        for (int32_t pc = 0; pc < func->code_len; pc++) {
+            const struct bc_instr *instr = &func->code[pc];
+
+            if (instr->op == BC_MOVE || instr->op == BC_SCAN) {
+                moves += instr->arg < 0 ? -(int64_t) instr->arg : instr->arg;
+            }
+            if (instr->op == BC_CHECK) {
+                continue;
             }
 
-            func->buff[func->head_pos] = subfunc.return_code;
-            return 0;
-            break;
+            int64_t last = instr->offset;
+            if (instr->op == BC_ADD_VEC) {
+                last += program->vecs[instr->arg].cells - 1;
+            }
+            if (instr->offset < frames->offset_min) {
+                frames->offset_min = instr->offset;
+            }
+            if (last > frames->offset_max) {
+                frames->offset_max = last;
+            }
         }
 
-        case SEM_ACTION_SYS_CALL:
-        {
-            return -1;
+        if (moves > moves_max) {
+            moves_max = moves;
         }
-
-        default:
-            return -1;
-            break;
     }
 
-    return -1;
+    int64_t offsets_span = frames->offset_max - frames->offset_min;
+
+    frames->guard_size = runtime_round_up(
+            (moves_max + offsets_span + 1) * frames->cell_size,
+            frames->page_size);
 }
 
 static int8_t
-runtime_func_run_cyc(struct runtime_func *func, struct sem_node *cyc)
+runtime_frames_init(
+        struct runtime_frames   *frames,
+        const struct bc_program *program,
+        uint32_t                 max_depth,
+        uint32_t                 tape_size,
+        int8_t                   checked)
 {
-    struct sem_node *body = &cyc->leaves[1];
+    if (max_depth == 0 || tape_size == 0 || tape_size > RUNTIME_MAX_TAPE_SIZE) {
+        return -1;
+    }
 
-    while (func->buff[func->head_pos]) {
-        for (int32_t i = 0; i < body->leaves_num; i++) {
-            struct sem_node *leaf = &body->leaves[i];
+    frames->depth = 0;
+    frames->max_depth = max_depth;
+    frames->checked = checked;
+    frames->cell_size = program->cell_size;
+    frames->page_size = sysconf(_SC_PAGESIZE);
+    frames->tape_size = tape_size;
+    frames->tape_bytes = (uint64_t) tape_size * frames->cell_size;
 
-            int8_t err = runtime_func_run_node(func, leaf);
-            if (err) {
-                return -1;
-            }
-            if (func->done) {
-                return 0;
-            }
-        }
+    runtime_frames_measure(frames, program);
+
+    frames->stack = calloc(max_depth, sizeof(*frames->stack));
+    if (!frames->stack) {
+        return -1;
+    }
+
+    frames->committed = calloc(max_depth, sizeof(*frames->committed));
+    if (!frames->committed) {
+        return -1;
+    }
+
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+
+    frames->mem_size = frames->guard_size
+            + max_depth * (frames->tape_bytes + frames->guard_size);
+    int prot = checked ? PROT_READ | PROT_WRITE : PROT_NONE;
+    frames->mem = mmap(NULL, frames->mem_size, prot, flags, -1, 0);
+    if (frames->mem == MAP_FAILED) {
+        frames->mem = NULL;
+        return -1;
     }
 
     return 0;
 }
 
+static void
+runtime_frames_free(struct runtime_frames *frames)
+{
+    if (frames->mem) {
+        munmap(frames->mem, frames->mem_size);
+        frames->mem = NULL;
+    }
+
+    free(frames->stack);
+    frames->stack = NULL;
+    free(frames->committed);
+    frames->committed = NULL;
+}
+
+static uint8_t *
+runtime_frames_tape(struct runtime_frames *frames, uint64_t slot)
+{
+    return &frames->mem[frames->guard_size + slot * (frames->tape_bytes + frames->guard_size)];
+}
+
+// Makes the tape of slot accessible up to at least size bytes, it is called
+// from the fault handler too.
 static int8_t
-runtime_func_run_node(struct runtime_func *func, struct sem_node *node)
+runtime_frames_commit(struct runtime_frames *frames, uint64_t slot, uint64_t size)
 {
-    if (node->type == SEM_CYC) {
-        int8_t err = runtime_func_run_cyc(func, node);
-        if (err) {
-            return -1;
+    uint64_t committed = frames->committed[slot];
+    if (size <= committed) {
+        return 0;
+    }
+
+    if (frames->checked) {
+        frames->committed[slot] = frames->tape_bytes;
+        return 0;
+    }
+
+    uint64_t new_size = committed * 2;
+    if (new_size < size) {
+        new_size = size;
+    }
+    new_size = runtime_round_up(new_size, frames->page_size);
+    if (new_size > frames->tape_bytes) {
+        new_size = frames->tape_bytes;
+    }
+
+    uint8_t *tape = runtime_frames_tape(frames, slot);
+    if (mprotect(&tape[committed], new_size - committed, PROT_READ | PROT_WRITE)) {
+        return -1;
+    }
+    frames->committed[slot] = new_size;
+
+    return 0;
+}
+
+struct runtime_func *
+runtime_frames_push(struct runtime *runtime, uint32_t func_pos)
+{
+    struct runtime_frames *frames = &runtime->frames;
+
+    if (func_pos >= (uint32_t) runtime->program.funcs_num) {
+        return NULL;
+    }
+    if (frames->depth >= frames->max_depth) {
+        return NULL;
+    }
+
+    uint32_t slot = frames->depth++;
+    struct runtime_func *func = &frames->stack[slot];
+    uint8_t *buff = runtime_frames_tape(frames, slot);
+
+    int8_t err = runtime_frames_commit(
+            frames, slot,
+            RUNTIME_FUNC_DEFAULT_STACK_SIZE * frames->cell_size);
+    if (err) {
+        frames->depth--;
+        return NULL;
+    }
+
+    // The previous frame of this depth left its head range behind.
+    int64_t begin = ((int64_t) func->head_min + frames->offset_min) * frames->cell_size;
+    int64_t end = ((int64_t) func->head_max + frames->offset_max + 1) * frames->cell_size;
+    if (begin < 0) {
+        begin = 0;
+    }
+    if (end > (int64_t) frames->committed[slot]) {
+        end = frames->committed[slot];
+    }
+    if (begin < end) {
+        memset(&buff[begin], 0, end - begin);
+    }
+
+    memset(func, 0, sizeof(*func));
+    func->index = func_pos;
+    func->buff = buff;
+
+    return func;
+}
+
+struct runtime_func *
+runtime_frames_pop(struct runtime *runtime)
+{
+    struct runtime_frames *frames = &runtime->frames;
+
+    frames->depth--;
+    if (frames->depth == 0) {
+        return NULL;
+    }
+
+    return &frames->stack[frames->depth - 1];
+}
+
+static struct runtime_frames *runtime_fault_frames;
+
+// Only the tape of the top frame is in use, a fault anywhere else in the
+// region is out of bounds. Faults outside of the region are not ours, the
+// default action runs when the access is retried.
+static void
+runtime_frames_fault(int sig, siginfo_t *info, void *context)
+{
+    (void) context;
+
+    struct runtime_frames *frames = runtime_fault_frames;
+    uint8_t *addr = info->si_addr;
+
+    if (!frames || addr < frames->mem || addr >= &frames->mem[frames->mem_size]) {
+        signal(sig, SIG_DFL);
+        return;
+    }
+
+    uint64_t slot = frames->depth - 1;
+    uint8_t *tape = frames->depth > 0 ? runtime_frames_tape(frames, slot) : NULL;
+
+    if (tape && addr >= tape && addr < &tape[frames->tape_bytes]) {
+        uint64_t pos = addr - tape;
+        if (pos < frames->committed[slot]) {
+            signal(sig, SIG_DFL);
+            return;
         }
-        if (func->done) {
-            return 0;
+
+        int8_t err = runtime_frames_commit(frames, slot, pos + 1);
+        if (!err) {
+            return;
         }
     }
 
-    if (sem_node_is_action(node->type)) {
-        int8_t err = runtime_func_run_action(func, node->type);
+    siglongjmp(frames->fault_jmp, 1);
+}
+
+int8_t
+runtime_init(
+        struct runtime               *runtime,
+        const struct sem_tree        *sem_tree,
+        const struct runtime_options *options)
+{
+    if (!runtime || !sem_tree || !options) {
+        return -1;
+    }
+    if (options->engine >= RUNTIME_ENGINES_NUM) {
+        return -1;
+    }
+    if (options->tape_size == 0 || options->tape_size > RUNTIME_MAX_TAPE_SIZE) {
+        return -1;
+    }
+
+    runtime->options = *options;
+    runtime->engine_data = NULL;
+
+    scan_init();
+    vec_init();
+
+    int8_t err = runtime_output_init(&runtime->output, options->output_size, STDOUT_FILENO);
+    if (err) {
+        return -1;
+    }
+
+    err = bc_program_init(&runtime->program, sem_tree, options->cell_size);
+    if (err) {
+        return -1;
+    }
+
+    // The passes and the frames all work with the tape the program really
+    // gets.
+    uint32_t tape_size = runtime_tape_size(options->tape_size, runtime->program.cell_size);
+
+    err = bc_program_optimize(&runtime->program, tape_size);
+    if (err) {
+        return -1;
+    }
+
+    if (options->checked) {
+        err = bc_program_insert_checks(&runtime->program, tape_size);
         if (err) {
             return -1;
         }
     }
 
+    err = runtime_frames_init(
+            &runtime->frames,
+            &runtime->program,
+            options->max_depth,
+            tape_size,
+            options->checked);
+    if (err) {
+        return -1;
+    }
+
+    const struct runtime_engine_ops *engine = &runtime_engines[options->engine];
+    if (engine->prepare) {
+        return engine->prepare(runtime);
+    }
+
     return 0;
 }
 
-static int8_t
-runtime_func_run(struct runtime_func *func)
+void
+runtime_free(struct runtime *runtime)
+{
+    if (!runtime) {
+        return;
+    }
+
+    const struct runtime_engine_ops *engine = &runtime_engines[runtime->options.engine];
+    if (engine->free) {
+        engine->free(runtime);
+    }
+
+    bc_program_free(&runtime->program);
+    runtime_frames_free(&runtime->frames);
+
+    free(runtime->output.buff);
+    runtime->output.buff = NULL;
+}
+
+int8_t
+runtime_func_call(struct runtime *runtime, uint32_t func_pos, uint32_t *return_code)
 {
+    uint32_t depth = runtime->frames.depth;
+
+    struct runtime_func *func = runtime_frames_push(runtime, func_pos);
     if (!func) {
         return -1;
     }
 
-    struct sem_node *sem_node = func->sem_node;
-    struct sem_node *leaves = sem_node->leaves;
+    int8_t err = runtime_engines[runtime->options.engine].run(runtime, func);
+    runtime->frames.depth = depth;
+    if (err) {
+        return -1;
+    }
 
-    for (int32_t i = 0; i < sem_node->leaves_num; i++) {
-        struct sem_node *leaf = &leaves[i];
+    *return_code = func->return_code;
 
-        int8_t err = runtime_func_run_node(func, leaf);
-        if (err) {
-            return -1;
-        }
-        if (func->done) {
-            return 0;
-        }
+    return 0;
+}
+
+// The prompt must be visible before the program blocks on input.
+int32_t
+runtime_input(struct runtime *runtime)
+{
+    struct runtime_output *output = &runtime->output;
+    if (output->interactive && output->len > 0) {
+        runtime_output_flush(output);
+    }
+
+    return getc(stdin);
+}
+
+// The syscall may write to stdout or never return, so the program output
+// produced so far goes first. The kernel does not fault on the part of the
+// tape that is not accessible yet, it fails, so the pointer arguments are
+// made accessible here.
+int8_t
+runtime_sys_call(struct runtime *runtime, void *cell, void *end)
+{
+    struct runtime_frames *frames = &runtime->frames;
+
+    int8_t err = runtime_output_flush(&runtime->output);
+    if (err) {
+        return -1;
+    }
+
+    struct sys_call call;
+    err = sys_call_decode(&call, cell, end, frames->cell_size);
+    if (err) {
+        return -1;
+    }
+
+    uint64_t slot = frames->depth - 1;
+    err = runtime_frames_commit(frames, slot, call.end - runtime_frames_tape(frames, slot));
+    if (err) {
+        return -1;
     }
 
-    func->done = 1;
-    func->return_code = func->buff[func->head_pos];
+    sys_call_exec(&call, cell, frames->cell_size);
+
     return 0;
 }
 
 int8_t
 runtime_run(struct runtime *runtime)
 {
-    if (!runtime || !runtime->sem_root) {
+    if (!runtime) {
         return -1;
     }
 
-    if (runtime->sem_root->leaves_num == 0) {
+    if (runtime->program.funcs_num == 0) {
         return 0;
     }
 
-    struct runtime_func main = {0};
-    main.sem_node = &runtime->sem_root->leaves[0];
+    // The checked mode needs no fault handler.
+    int8_t guarded = !runtime->options.checked;
+
+    struct sigaction action = {0};
+    action.sa_sigaction = runtime_frames_fault;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+
+    struct sigaction old_action;
+    if (guarded) {
+        if (sigaction(SIGSEGV, &action, &old_action)) {
+            return -1;
+        }
+        runtime_fault_frames = &runtime->frames;
+    }
+
+    uint32_t return_code = 0;
+    volatile int8_t err = -1;
+
+    // An out of bounds access lands here with a runtime error.
+    runtime->frames.out_of_bounds = 0;
+    if (!sigsetjmp(runtime->frames.fault_jmp, 1)) {
+        err = runtime_func_call(runtime, 0, &return_code);
+    } else {
+        runtime->frames.out_of_bounds = 1;
+    }
+    runtime->frames.depth = 0;
+
+    if (guarded) {
+        runtime_fault_frames = NULL;
+        sigaction(SIGSEGV, &old_action, NULL);
+    }
+
+    // The output written before a runtime error is flushed as well.
+    int8_t flush_err = runtime_output_flush(&runtime->output);
+    if (err || flush_err) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int8_t
+runtime_err_to_stderr(struct runtime *runtime)
+{
+    if (!runtime) {
+        return -1;
+    }
+
+    const char *err_msg = "Error: runtime error.\n";
+    if (runtime->frames.out_of_bounds) {
+        err_msg = "Error: tape access out of bounds.\n";
+    }
 
-    return runtime_func_run(&main);
+    if (fputs(err_msg, stderr) < 0) {
+        return -1;
+    }
+
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,265 @@
+/*
+ * See interpreter/include/scan.h for details.
+ *
+ * Zherdev, 2021
+ */
+
+#define _GNU_SOURCE
+
+#include "scan.h"
+#include "cell.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SCAN_X86_64
+
+#include <immintrin.h>
+#endif
+
+typedef uint8_t *(*scan_kernel)(uint8_t *pos, uint8_t *edge, int32_t stride);
+
+// For every stride the candidate cells inside a vector block depend on the
+// distance (phase) from the block edge to the first candidate, so the masks
+// and the phase of the following block are precomputed for each phase.
+struct scan_masks {
+    uint32_t right[SCAN_MAX_VEC_STRIDE];
+    uint32_t left[SCAN_MAX_VEC_STRIDE];
+    uint8_t  next[SCAN_MAX_VEC_STRIDE];
+};
+
+#define CELL uint8_t
+#define CELL_BITS 8
+#include "scan.inc"
+#undef CELL_BITS
+#undef CELL
+
+#define CELL uint16_t
+#define CELL_BITS 16
+#include "scan.inc"
+#undef CELL_BITS
+#undef CELL
+
+#define CELL uint32_t
+#define CELL_BITS 32
+#include "scan.inc"
+#undef CELL_BITS
+#undef CELL
+
+static scan_kernel scan_right_vec = scan_right_scalar_8;
+static scan_kernel scan_left_vec  = scan_left_scalar_8;
+
+#ifdef SCAN_X86_64
+
+static struct scan_masks scan_masks_sse2[SCAN_MAX_VEC_STRIDE + 1];
+static struct scan_masks scan_masks_avx2[SCAN_MAX_VEC_STRIDE + 1];
+
+static void
+scan_masks_build(struct scan_masks *masks, int32_t width, int32_t stride)
+{
+    for (int32_t phase = 0; phase < stride; phase++) {
+        uint32_t right = 0;
+        uint32_t left = 0;
+        int32_t i = phase;
+
+        for (; i < width; i += stride) {
+            right |= 1u << i;
+            left |= 1u << (width - 1 - i);
+        }
+
+        masks->right[phase] = right;
+        masks->left[phase] = left;
+        masks->next[phase] = i - width;
+    }
+}
+
+static uint8_t *
+scan_right_sse2(uint8_t *pos, uint8_t *end, int32_t stride)
+{
+    const struct scan_masks *masks = &scan_masks_sse2[stride];
+    const __m128i zero = _mm_setzero_si128();
+    int32_t phase = 0;
+    ptrdiff_t i = 0;
+
+    for (; end - pos - i >= 16; i += 16) {
+        __m128i cells = _mm_loadu_si128((const __m128i *) &pos[i]);
+        uint32_t hits = _mm_movemask_epi8(_mm_cmpeq_epi8(cells, zero));
+
+        hits &= masks->right[phase];
+        if (hits) {
+            return &pos[i + __builtin_ctz(hits)];
+        }
+        phase = masks->next[phase];
+    }
+
+    return scan_right_scalar_8(&pos[i + phase], end, stride);
+}
+
+static uint8_t *
+scan_left_sse2(uint8_t *pos, uint8_t *begin, int32_t stride)
+{
+    const struct scan_masks *masks = &scan_masks_sse2[stride];
+    const __m128i zero = _mm_setzero_si128();
+    int32_t phase = 0;
+    ptrdiff_t i = pos - begin;
+
+    for (; i >= 15; i -= 16) {
+        __m128i cells = _mm_loadu_si128((const __m128i *) &begin[i - 15]);
+        uint32_t hits = _mm_movemask_epi8(_mm_cmpeq_epi8(cells, zero));
+
+        hits &= masks->left[phase];
+        if (hits) {
+            return &begin[i - 15 + 31 - __builtin_clz(hits)];
+        }
+        phase = masks->next[phase];
+    }
+
+    if (i - phase < 0) {
+        return NULL;
+    }
+
+    return scan_left_scalar_8(&begin[i - phase], begin, stride);
+}
+
+__attribute__((target("avx2")))
+static uint8_t *
+scan_right_avx2(uint8_t *pos, uint8_t *end, int32_t stride)
+{
+    const struct scan_masks *masks = &scan_masks_avx2[stride];
+    const __m256i zero = _mm256_setzero_si256();
+    int32_t phase = 0;
+    ptrdiff_t i = 0;
+
+    for (; end - pos - i >= 32; i += 32) {
+        __m256i cells = _mm256_loadu_si256((const __m256i *) &pos[i]);
+        uint32_t hits = _mm256_movemask_epi8(_mm256_cmpeq_epi8(cells, zero));
+
+        hits &= masks->right[phase];
+        if (hits) {
+            return &pos[i + __builtin_ctz(hits)];
+        }
+        phase = masks->next[phase];
+    }
+
+    return scan_right_scalar_8(&pos[i + phase], end, stride);
+}
+
+__attribute__((target("avx2")))
+static uint8_t *
+scan_left_avx2(uint8_t *pos, uint8_t *begin, int32_t stride)
+{
+    const struct scan_masks *masks = &scan_masks_avx2[stride];
+    const __m256i zero = _mm256_setzero_si256();
+    int32_t phase = 0;
+    ptrdiff_t i = pos - begin;
+
+    for (; i >= 31; i -= 32) {
+        __m256i cells = _mm256_loadu_si256((const __m256i *) &begin[i - 31]);
+        uint32_t hits = _mm256_movemask_epi8(_mm256_cmpeq_epi8(cells, zero));
+
+        hits &= masks->left[phase];
+        if (hits) {
+            return &begin[i - 31 + 31 - __builtin_clz(hits)];
+        }
+        phase = masks->next[phase];
+    }
+
+    if (i - phase < 0) {
+        return NULL;
+    }
+
+    return scan_left_scalar_8(&begin[i - phase], begin, stride);
+}
+
+#endif // SCAN_X86_64
+
+void
+scan_init(void)
+{
+#ifdef SCAN_X86_64
+    for (int32_t stride = 1; stride <= SCAN_MAX_VEC_STRIDE; stride++) {
+        scan_masks_build(&scan_masks_sse2[stride], 16, stride);
+        scan_masks_build(&scan_masks_avx2[stride], 32, stride);
+    }
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scan_right_vec = scan_right_avx2;
+        scan_left_vec = scan_left_avx2;
+    } else {
+        scan_right_vec = scan_right_sse2;
+        scan_left_vec = scan_left_sse2;
+    }
+#endif
+}
+
+// Zeros in 8 bit cells are found with memchr() and vector compares, wider
+// cells are scanned one by one.
+void *
+scan_right_8(void *pos_, void *end_, int32_t stride)
+{
+    uint8_t *pos = pos_;
+    uint8_t *end = end_;
+
+    if (pos >= end) {
+        return NULL;
+    }
+
+    if (stride == 1) {
+        return memchr(pos, 0, end - pos);
+    }
+
+    if (stride <= SCAN_MAX_VEC_STRIDE) {
+        return scan_right_vec(pos, end, stride);
+    }
+
+    return scan_right_scalar_8(pos, end, stride);
+}
+
+void *
+scan_left_8(void *pos_, void *begin_, int32_t stride)
+{
+    uint8_t *pos = pos_;
+    uint8_t *begin = begin_;
+
+    if (pos < begin) {
+        return NULL;
+    }
+
+#ifdef __GLIBC__
+    if (stride == 1) {
+        return memrchr(begin, 0, pos - begin + 1);
+    }
+#endif
+
+    if (stride <= SCAN_MAX_VEC_STRIDE) {
+        return scan_left_vec(pos, begin, stride);
+    }
+
+    return scan_left_scalar_8(pos, begin, stride);
+}
+
+void *
+scan_right_16(void *pos, void *end, int32_t stride)
+{
+    return scan_right_scalar_16(pos, end, stride);
+}
+
+void *
+scan_left_16(void *pos, void *begin, int32_t stride)
+{
+    return scan_left_scalar_16(pos, begin, stride);
+}
+
+void *
+scan_right_32(void *pos, void *end, int32_t stride)
+{
+    return scan_right_scalar_32(pos, end, stride);
+}
+
+void *
+scan_left_32(void *pos, void *begin, int32_t stride)
+{
+    return scan_left_scalar_32(pos, begin, stride);
+}
\ No newline at end of file
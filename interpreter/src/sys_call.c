@@ -0,0 +1,117 @@
+/*
+ * See interpreter/include/sys_call.h for details.
+ *
+ * Zherdev, 2021
+ */
+
+#define _GNU_SOURCE
+
+#include "sys_call.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+// The syscalls are slow anyway, so the cell width is looked at on every
+// access.
+static uint32_t
+sys_call_load(const uint8_t *cells, int64_t index, uint8_t cell_size)
+{
+    switch (cell_size) {
+        case 2:
+            return ((const uint16_t *) cells)[index];
+        case 4:
+            return ((const uint32_t *) cells)[index];
+        default:
+            return cells[index];
+    }
+}
+
+static void
+sys_call_store(uint8_t *cells, uint32_t value, uint8_t cell_size)
+{
+    switch (cell_size) {
+        case 2:
+            *(uint16_t *) cells = value;
+            break;
+        case 4:
+            *(uint32_t *) cells = value;
+            break;
+        default:
+            *cells = value;
+            break;
+    }
+}
+
+int8_t
+sys_call_decode(struct sys_call *call, void *cell_, void *end_, uint8_t cell_size)
+{
+    uint8_t *cell = cell_;
+    uint8_t *end = end_;
+
+    if (!call || !cell || !end || end < cell || (end - cell) / cell_size < 2) {
+        return -1;
+    }
+
+    call->number = sys_call_load(cell, 0, cell_size);
+    uint32_t args_num = sys_call_load(cell, 1, cell_size);
+    if (args_num > SYS_CALL_MAX_ARGS) {
+        return -1;
+    }
+
+    long *args = call->args;
+    memset(args, 0, sizeof(call->args));
+    uint8_t *pos = &cell[2 * cell_size];
+
+    for (uint32_t i = 0; i < args_num; i++) {
+        if ((end - pos) / cell_size < 2) {
+            return -1;
+        }
+
+        uint32_t type = sys_call_load(pos, 0, cell_size);
+        uint32_t len = sys_call_load(pos, 1, cell_size);
+        pos += 2 * cell_size;
+
+        if ((uint64_t) ((end - pos) / cell_size) < len) {
+            return -1;
+        }
+
+        switch (type) {
+            case SYS_CALL_ARG_VALUE:
+            {
+                unsigned long value = 0;
+                for (uint32_t j = 0; j < len; j++) {
+                    value = value << (8 * cell_size) | sys_call_load(pos, j, cell_size);
+                }
+                args[i] = value;
+                break;
+            }
+
+            case SYS_CALL_ARG_POINTER:
+                args[i] = (long) pos;
+                break;
+
+            default:
+                return -1;
+                break;
+        }
+
+        pos += (uint64_t) len * cell_size;
+    }
+    call->end = pos;
+
+    return 0;
+}
+
+void
+sys_call_exec(const struct sys_call *call, void *cell, uint8_t cell_size)
+{
+    const long *args = call->args;
+
+    // The result is stored like the raw kernel one, -errno on failure.
+    long res = syscall(call->number, args[0], args[1], args[2], args[3], args[4], args[5]);
+    if (res == -1) {
+        res = -errno;
+    }
+    sys_call_store(cell, res, cell_size);
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+/*
+ * See interpreter/include/vec.h for details.
+ *
+ * Zherdev, 2021
+ */
+
+#include "vec.h"
+#include "cell.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define VEC_X86_64
+
+#include <immintrin.h>
+#endif
+
+typedef void (*vec_kernel)(void *cells, const struct bc_vec *vec);
+
+#define CELL uint8_t
+#define CELL_BITS 8
+#include "vec.inc"
+#undef CELL_BITS
+#undef CELL
+
+#define CELL uint16_t
+#define CELL_BITS 16
+#include "vec.inc"
+#undef CELL_BITS
+#undef CELL
+
+#define CELL uint32_t
+#define CELL_BITS 32
+#include "vec.inc"
+#undef CELL_BITS
+#undef CELL
+
+static vec_kernel vec_add_kernel_8  = vec_add_scalar_8;
+static vec_kernel vec_add_kernel_16 = vec_add_scalar_16;
+static vec_kernel vec_add_kernel_32 = vec_add_scalar_32;
+
+void
+vec_init(void)
+{
+#ifdef VEC_X86_64
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        vec_add_kernel_8 = vec_add_avx2_8;
+        vec_add_kernel_16 = vec_add_avx2_16;
+        vec_add_kernel_32 = vec_add_avx2_32;
+    } else {
+        vec_add_kernel_8 = vec_add_sse2_8;
+        vec_add_kernel_16 = vec_add_sse2_16;
+        vec_add_kernel_32 = vec_add_sse2_32;
+    }
+#endif
+}
+
+void
+vec_add_8(void *cells, const struct bc_vec *vec)
+{
+    vec_add_kernel_8(cells, vec);
+}
+
+void
+vec_add_16(void *cells, const struct bc_vec *vec)
+{
+    vec_add_kernel_16(cells, vec);
+}
+
+void
+vec_add_32(void *cells, const struct bc_vec *vec)
+{
+    vec_add_kernel_32(cells, vec);
+}
\ No newline at end of file
@@ -36,17 +36,32 @@ enum lex_terminal {
 };
 
 struct lex_parser {
-    int32_t fd;
+    const char *buff;
+    uint64_t buff_len;
+
+    uint8_t *tokens;
+    uint64_t tokens_num;
+    uint64_t pos;
+
     enum lex_terminal next;
     char parsed;
+    char unknown;
 };
 
 int8_t
-lex_parser_init(struct lex_parser *parser, int32_t fd);
+lex_parser_init(struct lex_parser *parser, const char *buff, uint64_t buff_len);
+
+void
+lex_parser_free(struct lex_parser *parser);
 
 int8_t
 lex_parser_read(struct lex_parser *parser);
 
+// Leaves the parser as if the tokens before pos had been read one by one
+// with lex_parser_read(), for parsers that walk the tokens themselves.
+int8_t
+lex_parser_seek(struct lex_parser *parser, uint64_t pos);
+
 int8_t
 lex_is_common_symbol(enum lex_terminal lex);
 
@@ -11,16 +11,28 @@
 
 #include <stdint.h>
 
+enum parser_source {
+    PARSER_SOURCE_BUFFER, // owned by the caller
+    PARSER_SOURCE_MMAP,
+    PARSER_SOURCE_HEAP
+};
+
 struct parser {
     struct lex_parser   lexer;
     struct syn_parser   syntaxer;
     struct sem_analyzer analyzer;
-    int32_t fd;
+
+    enum parser_source  source;
+    char               *buff;
+    uint64_t            buff_len;
 };
 
 int8_t
 parser_init(struct parser *parser, const char *filename);
 
+int8_t
+parser_init_buffer(struct parser *parser, const char *buff, uint64_t buff_len);
+
 int8_t
 parser_free(struct parser *parser);
 
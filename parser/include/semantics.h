@@ -17,9 +17,6 @@ enum sem_node_type {
     SEM_FUNC,
 
     SEM_CYC,
-    SEM_CYC_START,
-    SEM_CYC_BODY,
-    SEM_CYC_END,
 
     SEM_ACTION_INC,
     SEM_ACTION_DEC,
@@ -34,21 +31,38 @@ enum sem_node_type {
     SEM_ACTION_SYS_CALL
 };
 
+// Nodes are stored in preorder: the leaves of a node follow it and its next
+// sibling comes right after its subtree. The leaves of a loop are its body.
 struct sem_node {
-    enum   sem_node_type  type;
-    struct sem_node      *root;
-    struct sem_node      *leaves;
-    int32_t               leaves_num;
-    int32_t               leaves_max_num;
+    uint8_t type; // enum sem_node_type
+    int32_t size; // nodes in the subtree, the node included
+};
+
+// Every node is bumped off a single arena, nodes[0] is the root. A source
+// has at most one node per token plus the root, so the arena is reserved
+// once and freed at once.
+struct sem_tree {
+    struct sem_node *nodes;
+    int32_t          nodes_num;
+    int32_t          nodes_max_num;
 };
 
 struct sem_analyzer {
-    struct sem_node    tree;
-    struct sem_node   *cur_node;
+    struct sem_tree    tree;
+    int32_t            cur_node;
     struct lex_parser *lexer;
     struct syn_parser *syntaxer;
 };
 
+// Index right behind the subtree of node: its next sibling or the end of
+// the leaves of its parent. The leaves of node run from node + 1 to
+// sem_tree_next(tree, node).
+static inline int32_t
+sem_tree_next(const struct sem_tree *tree, int32_t node)
+{
+    return node + tree->nodes[node].size;
+}
+
 int8_t
 sem_analyzer_init(
         struct sem_analyzer *res,
@@ -9,36 +9,23 @@
 
 #include <stdint.h>
 
+// A source is parsed in a single pass over its tokens by
+// sem_analyzer_process(), every line is a function:
+//     source   = { function } EOF
+//     function = { symbol | cycle } [ COMMENT ] DELIM
+//     cycle    = CYC_START { symbol | cycle } CYC_END
+// The first token that does not fit is the error.
+
+// The codes are printed in the error messages.
 enum syn_state {
-    SYN_START,
-    SYN_END,
-
-    SYN_FUNC,
-    SYN_FUNC_BODY,
-
-    SYN_CONSTRUCT,
-
-    SYN_SYMBOL,
-
-    SYN_CYC,
-    SYN_CYC_START,
-    SYN_CYC_END,
-
-    SYN_COMMENT,
-    SYN_COMMENT_START,
-    SYN_DELIM,
-    SYN_ERR
-};
-
-struct syn_magazine {
-    enum syn_state *buff;
-    int32_t pos;
-    int32_t size;
+    SYN_START     = 0,  // between functions
+    SYN_END       = 1,
+    SYN_FUNC_BODY = 3,  // inside of a function
+    SYN_ERR       = 12
 };
 
 struct syn_parser {
-    struct syn_magazine magazine;
-    int8_t need_next_lex;
+    enum syn_state state;
 };
 
 int8_t
@@ -47,9 +34,6 @@ syn_parser_init(struct syn_parser *parser);
 void
 syn_parser_free(struct syn_parser *parser);
 
-int8_t
-syn_parser_process_lex(struct syn_parser *parser, enum lex_terminal lex);
-
 enum syn_state
 syn_parser_cur_state(struct syn_parser *parser);
 
@@ -1,115 +1,123 @@
 /*
  * See parser/include/lex.h for details.
  *
+ * The whole source is lexed at once into an array of one byte tokens.
+ * A comment (a space up to the end of the line) becomes a single
+ * LEX_COMMENT token and its text is skipped with memchr(), which is
+ * SSE2/AVX2 vectorized in the libc.
+ *
  * Zherdev, 2021
  */
 
 #include "lex.h"
 
-#include <fcntl.h>
-#include <ctype.h>
-#include <sys/types.h>
-#include <unistd.h>
-
-#ifdef __linux
-
-#include <sys/io.h>
-
-#elif defined(__osx)
-
-#include <sys/uio.h>
-#endif
-
-int8_t
-lex_parser_init(struct lex_parser *parser, int32_t fd)
+#include <stdlib.h>
+#include <string.h>
+
+static const char lex_terminal_chars[LEX_EOF] = {
+    [LEX_INC]       = '+',
+    [LEX_DEC]       = '-',
+    [LEX_LEFT]      = '<',
+    [LEX_RIGHT]     = '>',
+    [LEX_CYC_START] = '[',
+    [LEX_CYC_END]   = ']',
+    [LEX_INPUT]     = ',',
+    [LEX_OUTPUT]    = '.',
+    [LEX_UP]        = '^',
+    [LEX_DOWN]      = 'v',
+    [LEX_FUNC_CALL] = ':',
+    [LEX_RETURN]    = ';',
+    [LEX_SYS_CALL]  = '%',
+    [LEX_COMMENT]   = ' ',
+    [LEX_DELIM]     = '\n',
+};
+
+static uint8_t lex_table[256];
+static int8_t  lex_table_ready;
+
+static void
+lex_table_init(void)
 {
-    if (!parser) {
-        return -1;
+    if (lex_table_ready) {
+        return;
     }
 
-    parser->fd = fd;
-    parser->next = LEX_UNK;
-    parser->parsed = 0;
+    memset(lex_table, LEX_UNK, sizeof(lex_table));
+    for (int32_t lex = 0; lex < LEX_EOF; lex++) {
+        lex_table[(uint8_t) lex_terminal_chars[lex]] = lex;
+    }
 
-    return 0;
+    lex_table_ready = 1;
 }
 
-static int8_t
-lex_fd_is_ok(int32_t fd)
+// Lexing stops at the first unknown symbol, it is always a syntax error.
+static void
+lex_parser_tokenize(struct lex_parser *parser)
 {
-    return fcntl(fd, F_GETFD) != -1;
-}
+    const uint8_t *buff = (const uint8_t *) parser->buff;
+    uint64_t len = parser->buff_len;
+    uint8_t *tokens = parser->tokens;
+    uint64_t tokens_num = 0;
+    uint64_t pos = 0;
 
-static int8_t
-lex_parser_parse_char(struct lex_parser *parser, char ch)
-{
-    switch (ch) {
-        case '+':
-            parser->next = LEX_INC;
-            break;
+    while (pos < len) {
+        uint8_t lex = lex_table[buff[pos]];
+        tokens[tokens_num++] = lex;
 
-        case '-':
-            parser->next = LEX_DEC;
-            break;
-
-        case '<':
-            parser->next = LEX_LEFT;
-            break;
-
-        case '>':
-            parser->next = LEX_RIGHT;
-            break;
-
-        case '[':
-            parser->next = LEX_CYC_START;
-            break;
+        if (lex == LEX_COMMENT) {
+            const uint8_t *delim = memchr(&buff[pos + 1], '\n', len - pos - 1);
+            pos = delim ? (uint64_t) (delim - buff) : len;
+            continue;
+        }
 
-        case ']':
-            parser->next = LEX_CYC_END;
+        if (lex == LEX_UNK) {
+            parser->unknown = buff[pos];
             break;
+        }
 
-        case ',':
-            parser->next = LEX_INPUT;
-            break;
-
-        case '.':
-            parser->next = LEX_OUTPUT;
-            break;
+        pos++;
+    }
 
-        case '^':
-            parser->next = LEX_UP;
-            break;
+    tokens[tokens_num++] = LEX_EOF;
+    parser->tokens_num = tokens_num;
+}
 
-        case 'v':
-            parser->next = LEX_DOWN;
-            break;
+int8_t
+lex_parser_init(struct lex_parser *parser, const char *buff, uint64_t buff_len)
+{
+    if (!parser || (!buff && buff_len)) {
+        return -1;
+    }
 
-        case ':':
-            parser->next = LEX_FUNC_CALL;
-            break;
+    lex_table_init();
 
-        case ';':
-            parser->next = LEX_RETURN;
-            break;
+    parser->buff = buff;
+    parser->buff_len = buff_len;
+    parser->pos = 0;
+    parser->next = LEX_UNK;
+    parser->parsed = 0;
+    parser->unknown = 0;
 
-        case '%':
-            parser->next = LEX_SYS_CALL;
-            break;
+    parser->tokens = malloc(buff_len + 1);
+    if (!parser->tokens) {
+        return -1;
+    }
 
-        case ' ':
-            parser->next = LEX_COMMENT;
-            break;
+    lex_parser_tokenize(parser);
 
-        case '\n':
-            parser->next = LEX_DELIM;
-            break;
+    return 0;
+}
 
-        default:
-            parser->next = LEX_UNK;
-            break;
+void
+lex_parser_free(struct lex_parser *parser)
+{
+    if (!parser) {
+        return;
     }
 
-    return 0;
+    free(parser->tokens);
+    parser->tokens = NULL;
+    parser->tokens_num = 0;
 }
 
 int8_t
@@ -119,29 +127,37 @@ lex_parser_read(struct lex_parser *parser)
         return -1;
     }
 
-    if (!lex_fd_is_ok(parser->fd)) {
-        parser->next = LEX_ERR;
-        return -1;
+    if (parser->pos >= parser->tokens_num) {
+        parser->next = LEX_EOF;
+        return 0;
     }
 
-    int32_t res = read(parser->fd, &parser->parsed, sizeof(char));
-    switch (res) {
-        case sizeof(char):
-            return lex_parser_parse_char(parser, parser->parsed);
-            break;
+    enum lex_terminal lex = parser->tokens[parser->pos++];
+    parser->next = lex;
 
-        case 0:
-            parser->next = LEX_EOF;
-            return 0;
-            break;
+    if (lex == LEX_UNK) {
+        parser->parsed = parser->unknown;
+    } else if (lex != LEX_EOF) {
+        parser->parsed = lex_terminal_chars[lex];
+    }
 
-        default:
-            parser->next = LEX_ERR;
-            return -1;
-            break;
+    return 0;
+}
+
+int8_t
+lex_parser_seek(struct lex_parser *parser, uint64_t pos)
+{
+    if (!parser || pos == 0 || pos > parser->tokens_num) {
+        return -1;
+    }
+
+    // EOF keeps the symbol read before it.
+    parser->pos = pos >= 2 ? pos - 2 : 0;
+    if (pos >= 2) {
+        lex_parser_read(parser);
     }
 
-    return -1;
+    return lex_parser_read(parser);
 }
 
 int8_t
@@ -7,18 +7,99 @@
 #include "parser.h"
 
 #include <fcntl.h>
-#include <ctype.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
-#ifdef __linux
+#define PARSER_READ_BLOCK_SIZE (1 << 20)
 
-#include <sys/io.h>
+static int8_t
+parser_init_components(struct parser *parser)
+{
+    struct lex_parser   *lexer    = &parser->lexer;
+    struct syn_parser   *syntaxer = &parser->syntaxer;
+    struct sem_analyzer *analyzer = &parser->analyzer;
+
+    int8_t err = lex_parser_init(lexer, parser->buff, parser->buff_len);
+    if (err) {
+        return -1;
+    }
+
+
+    err = syn_parser_init(syntaxer);
+    if (err) {
+        return -1;
+    }
+
+
+    err = sem_analyzer_init(analyzer, lexer, syntaxer);
+    if (err) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int8_t
+parser_map_file(struct parser *parser, int32_t fd, uint64_t size)
+{
+    void *buff = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (buff == MAP_FAILED) {
+        return -1;
+    }
+    madvise(buff, size, MADV_SEQUENTIAL);
+
+    parser->source = PARSER_SOURCE_MMAP;
+    parser->buff = buff;
+    parser->buff_len = size;
+
+    return 0;
+}
+
+// Pipes, terminals and other unmappable files are read in large blocks.
+static int8_t
+parser_read_file(struct parser *parser, int32_t fd)
+{
+    uint64_t max_len = PARSER_READ_BLOCK_SIZE;
+    uint64_t len = 0;
+
+    char *buff = malloc(max_len);
+    if (!buff) {
+        return -1;
+    }
 
-#elif defined(__osx)
+    for (;;) {
+        if (len == max_len) {
+            max_len *= 2;
+
+            char *new_buff = realloc(buff, max_len);
+            if (!new_buff) {
+                free(buff);
+                return -1;
+            }
+            buff = new_buff;
+        }
+
+        ssize_t res = read(fd, &buff[len], max_len - len);
+        if (res < 0) {
+            free(buff);
+            return -1;
+        }
+        if (res == 0) {
+            break;
+        }
+
+        len += res;
+    }
 
-#include <sys/uio.h>
-#endif
+    parser->source = PARSER_SOURCE_HEAP;
+    parser->buff = buff;
+    parser->buff_len = len;
+
+    return 0;
+}
 
 int8_t
 parser_init(struct parser *parser, const char *filename)
@@ -27,34 +108,46 @@ parser_init(struct parser *parser, const char *filename)
         return -1;
     }
 
-    struct lex_parser   *lexer    = &parser->lexer;
-    struct syn_parser   *syntaxer = &parser->syntaxer;
-    struct sem_analyzer *analyzer = &parser->analyzer;
-
-    int8_t fd = open(filename, O_RDONLY);
+    int32_t fd = open(filename, O_RDONLY);
     if (fd == -1) {
         return -1;
     }
-    parser->fd = fd;
 
-    int8_t err = lex_parser_init(lexer, fd);
+    struct stat st = {0};
+    int8_t err = fstat(fd, &st);
     if (err) {
+        close(fd);
         return -1;
     }
 
+    err = -1;
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        err = parser_map_file(parser, fd, st.st_size);
+    }
+    if (err) {
+        err = parser_read_file(parser, fd);
+    }
 
-    err = syn_parser_init(syntaxer);
+    close(fd);
     if (err) {
         return -1;
     }
 
+    return parser_init_components(parser);
+}
 
-    err = sem_analyzer_init(analyzer, lexer, syntaxer);
-    if (err) {
+int8_t
+parser_init_buffer(struct parser *parser, const char *buff, uint64_t buff_len)
+{
+    if (!parser || (!buff && buff_len)) {
         return -1;
     }
 
-    return 0;
+    parser->source = PARSER_SOURCE_BUFFER;
+    parser->buff = (char *) buff;
+    parser->buff_len = buff_len;
+
+    return parser_init_components(parser);
 }
 
 int8_t
@@ -64,14 +157,31 @@ parser_free(struct parser *parser)
         return 0;
     }
 
+    struct lex_parser   *lexer    = &parser->lexer;
     struct syn_parser   *syntaxer = &parser->syntaxer;
     struct sem_analyzer *analyzer = &parser->analyzer;
 
 
     sem_analyzer_free(analyzer);
     syn_parser_free(syntaxer);
+    lex_parser_free(lexer);
+
+    int8_t err = 0;
+    switch (parser->source) {
+        case PARSER_SOURCE_MMAP:
+            err = munmap(parser->buff, parser->buff_len);
+            break;
+
+        case PARSER_SOURCE_HEAP:
+            free(parser->buff);
+            break;
+
+        default:
+            break;
+    }
+    parser->buff = NULL;
+    parser->buff_len = 0;
 
-    int8_t err = close(parser->fd);
     if (err) {
         return -1;
     }
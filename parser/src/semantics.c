@@ -9,90 +9,39 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-static void
-sem_node_tree_free(struct sem_node *tree)
-{
-    if (!tree) {
-        return;
-    }
-
-    for (int32_t i = 0; i < tree->leaves_num; i++) {
-        sem_node_tree_free(&tree->leaves[i]);
-    }
-
-    free(tree->leaves);
-}
-
-static void
-sem_node_init(struct sem_node *node)
-{
-    node->leaves = NULL;
-    node->leaves = NULL;
-    node->leaves_max_num = 0;
-    node->leaves_num = 0;
-    node->type = 0;
-}
-
-static int32_t
-sem_node_alloc_leaves(struct sem_node *node)
+// While a node is open its size holds the index of its parent, the size is
+// known once the node is closed.
+static int8_t
+sem_analyzer_open_node(struct sem_analyzer *analyzer, enum sem_node_type node_type)
 {
-    const int32_t default_leaves_num = 32;
-
-    node->leaves = calloc(default_leaves_num, sizeof(*node->leaves));
-    if (!node->leaves) {
+    struct sem_tree *tree = &analyzer->tree;
+    if (tree->nodes_num >= tree->nodes_max_num) {
         return -1;
     }
 
-    node->leaves_max_num = default_leaves_num;
+    int32_t index = tree->nodes_num++;
+    tree->nodes[index].type = node_type;
+    tree->nodes[index].size = analyzer->cur_node;
+    analyzer->cur_node = index;
 
     return 0;
 }
 
-static int32_t
-sem_node_realloc_leaves(struct sem_node *node)
+static int8_t
+sem_analyzer_close_node(struct sem_analyzer *analyzer)
 {
-    int32_t new_size = node->leaves_max_num * 2;
-
-    node->leaves = realloc(node->leaves, new_size * sizeof(*node->leaves));
-    if (!node->leaves) {
+    struct sem_tree *tree = &analyzer->tree;
+    int32_t index = analyzer->cur_node;
+    if (index < 0) {
         return -1;
     }
 
-    node->leaves_max_num = new_size;
+    analyzer->cur_node = tree->nodes[index].size;
+    tree->nodes[index].size = tree->nodes_num - index;
 
     return 0;
 }
 
-static struct sem_node *
-sem_node_tree_add_leaf(struct sem_node *parent, enum sem_node_type leaf_type)
-{
-    if (!parent) {
-        return NULL;
-    }
-
-    if (!parent->leaves) {
-        int8_t err = sem_node_alloc_leaves(parent);
-        if (err) {
-            return NULL;
-        }
-    }
-
-    parent->leaves_num++;
-    if (parent->leaves_num >= parent->leaves_max_num) {
-        int8_t err = sem_node_realloc_leaves(parent);
-        if (err) {
-            return NULL;
-        }
-    }
-
-    struct sem_node *new_leaf = &parent->leaves[parent->leaves_num - 1];
-    sem_node_init(new_leaf);
-    new_leaf->type = leaf_type;
-    new_leaf->root = parent;
-
-    return new_leaf;
-}
-
 int8_t
 sem_analyzer_init(
         struct sem_analyzer *res,
@@ -105,212 +54,142 @@ sem_analyzer_init(
 
     res->lexer = lexer;
     res->syntaxer = syntaxer;
-    sem_node_init(&res->tree);
-    res->tree.type = SEM_ROOT;
-    res->cur_node = &res->tree;
-
-    return 0;
-}
 
-void
-sem_analyzer_free(struct sem_analyzer *analyzer)
-{
-    if (!analyzer) {
-        return;
-    }
-
-    sem_node_tree_free(&analyzer->tree);
-}
-
-static int8_t
-sem_symbol_to_action(enum lex_terminal symbol, enum sem_node_type *res)
-{
-    switch (symbol) {
-        case LEX_INC:
-            *res = SEM_ACTION_INC;
-            break;
-
-        case LEX_DEC:
-            *res = SEM_ACTION_DEC;
-            break;
-
-        case LEX_LEFT:
-            *res = SEM_ACTION_LEFT;
-            break;
-
-        case LEX_RIGHT:
-            *res = SEM_ACTION_RIGHT;
-            break;
-
-        case LEX_INPUT:
-            *res = SEM_ACTION_INPUT;
-            break;
-
-        case LEX_OUTPUT:
-            *res = SEM_ACTION_OUTPUT;
-            break;
-
-        case LEX_UP:
-            *res = SEM_ACTION_UP;
-            break;
-
-        case LEX_DOWN:
-            *res = SEM_ACTION_DOWN;
-            break;
-
-        case LEX_FUNC_CALL:
-            *res = SEM_ACTION_FUNC_CALL;
-            break;
-
-        case LEX_RETURN:
-            *res = SEM_ACTION_RETURN;
-            break;
-
-        case LEX_SYS_CALL:
-            *res = SEM_ACTION_SYS_CALL;
-            break;
-
-        default:
-            return -1;
-            break;
-    }
-
-    return 0;
-}
-
-static void
-sem_analyzer_go_to_parent_node(struct sem_analyzer *analyzer)
-{
-    struct sem_node *parent = analyzer->cur_node->root;
-    analyzer->cur_node = parent;
-}
-
-static int8_t
-sem_analyzer_add_node(struct sem_analyzer *analyzer, enum sem_node_type node_type)
-{
-    struct sem_node *new_node = sem_node_tree_add_leaf(analyzer->cur_node, node_type);
-    if (!new_node) {
+    // A function node is paid for by its delimiter, every other node by
+    // its own token.
+    if (lexer->tokens_num >= INT32_MAX) {
         return -1;
     }
+    int32_t max_num = lexer->tokens_num + 1;
 
-    analyzer->cur_node = new_node;
-
-    return 0;
-}
-
-static int8_t
-sem_analyzer_process_func(struct sem_analyzer *analyzer)
-{
-    return sem_analyzer_add_node(analyzer, SEM_FUNC);
-}
-
-static int8_t
-sem_analyzer_process_cyc(struct sem_analyzer *analyzer)
-{
-    return sem_analyzer_add_node(analyzer, SEM_CYC);
-}
-
-static int8_t
-sem_analyzer_process_cyc_start(struct sem_analyzer *analyzer)
-{
-    int8_t err = sem_analyzer_add_node(analyzer, SEM_CYC_START);
-    if (err) {
+    res->tree.nodes = malloc(max_num * sizeof(*res->tree.nodes));
+    if (!res->tree.nodes) {
         return -1;
     }
+    res->tree.nodes_num = 0;
+    res->tree.nodes_max_num = max_num;
 
-    sem_analyzer_go_to_parent_node(analyzer);
+    res->cur_node = -1;
 
-    err = sem_analyzer_add_node(analyzer, SEM_CYC_BODY);
-    if (err) {
-        return -1;
-    }
-
-    return 0;
+    return sem_analyzer_open_node(res, SEM_ROOT);
 }
 
-static int8_t
-sem_analyzer_process_cyc_end(struct sem_analyzer *analyzer)
+void
+sem_analyzer_free(struct sem_analyzer *analyzer)
 {
-    sem_analyzer_go_to_parent_node(analyzer);
-
-    int8_t err = sem_analyzer_add_node(analyzer, SEM_CYC_END);
-    if (err) {
-        return -1;
+    if (!analyzer) {
+        return;
     }
 
-    sem_analyzer_go_to_parent_node(analyzer);
-    return 0;
+    free(analyzer->tree.nodes);
+    analyzer->tree.nodes = NULL;
+    analyzer->tree.nodes_num = 0;
+    analyzer->tree.nodes_max_num = 0;
 }
 
+// Node types of the symbol tokens.
+static const uint8_t sem_actions[LEX_EOF] = {
+    [LEX_INC]       = SEM_ACTION_INC,
+    [LEX_DEC]       = SEM_ACTION_DEC,
+    [LEX_LEFT]      = SEM_ACTION_LEFT,
+    [LEX_RIGHT]     = SEM_ACTION_RIGHT,
+    [LEX_INPUT]     = SEM_ACTION_INPUT,
+    [LEX_OUTPUT]    = SEM_ACTION_OUTPUT,
+    [LEX_UP]        = SEM_ACTION_UP,
+    [LEX_DOWN]      = SEM_ACTION_DOWN,
+    [LEX_FUNC_CALL] = SEM_ACTION_FUNC_CALL,
+    [LEX_RETURN]    = SEM_ACTION_RETURN,
+    [LEX_SYS_CALL]  = SEM_ACTION_SYS_CALL,
+};
+
 static int8_t
-sem_analyzer_process_symbol(struct sem_analyzer *analyzer, enum lex_terminal symbol)
+sem_analyzer_add_leaf(struct sem_analyzer *analyzer, enum sem_node_type node_type)
 {
-    enum sem_node_type action = 0;
-    int8_t err = sem_symbol_to_action(symbol, &action);
-    if (err){
+    struct sem_tree *tree = &analyzer->tree;
+    if (tree->nodes_num >= tree->nodes_max_num) {
         return -1;
     }
 
-    err = sem_analyzer_add_node(analyzer, action);
-    if (err) {
-        return -1;
-    }
+    struct sem_node *node = &tree->nodes[tree->nodes_num++];
+    node->type = node_type;
+    node->size = 1;
 
-    sem_analyzer_go_to_parent_node(analyzer);
     return 0;
 }
 
+// A single pass over the tokens, see parser/include/syntax.h for the
+// grammar. A function is opened by its first token and closed by its
+// delimiter. Stops right behind the last token it has looked at.
 static int8_t
-sem_analyzer_process_node(
-        struct sem_analyzer *analyzer,
-        enum syn_state       state,
-        enum lex_terminal    lex)
+sem_analyzer_parse(struct sem_analyzer *analyzer, uint64_t *pos)
 {
-    if (!analyzer) {
-        return -1;
-    }
-
-    switch (state) {
-        case SYN_START: case SYN_FUNC_BODY: case SYN_CONSTRUCT:
-        case SYN_COMMENT_START: case SYN_COMMENT:
-            break;
-
-        case SYN_FUNC:
-            return sem_analyzer_process_func(analyzer);
-            break;
-
-        case SYN_SYMBOL:
-            return sem_analyzer_process_symbol(analyzer, lex);
-            break;
+    struct syn_parser *syntaxer = analyzer->syntaxer;
+    const uint8_t *tokens = analyzer->lexer->tokens;
+    uint64_t tokens_num = analyzer->lexer->tokens_num;
+    int32_t depth = 0;
 
-        case SYN_CYC:
-            return sem_analyzer_process_cyc(analyzer);
-            break;
+    while (*pos < tokens_num) {
+        enum lex_terminal lex = tokens[(*pos)++];
 
-        case SYN_CYC_START:
-            return sem_analyzer_process_cyc_start(analyzer);
+        if (lex == LEX_EOF && syntaxer->state == SYN_START) {
+            syntaxer->state = SYN_END;
+            return 0;
+        }
+        if (lex >= LEX_EOF) {
             break;
+        }
 
-        case SYN_CYC_END:
-        {
-            int8_t err = sem_analyzer_process_cyc_end(analyzer);
+        if (syntaxer->state == SYN_START && lex != LEX_CYC_END) {
+            int8_t err = sem_analyzer_open_node(analyzer, SEM_FUNC);
             if (err) {
                 return -1;
             }
-            return sem_analyzer_process_cyc_end(analyzer);
-            break;
+            syntaxer->state = SYN_FUNC_BODY;
         }
 
-        case SYN_DELIM:
-            sem_analyzer_go_to_parent_node(analyzer);
-            break;
+        int8_t err = 0;
+        switch (lex) {
+            case LEX_CYC_START:
+                err = sem_analyzer_open_node(analyzer, SEM_CYC);
+                depth++;
+                break;
+
+            case LEX_CYC_END:
+                if (depth == 0) {
+                    syntaxer->state = SYN_ERR;
+                    return -1;
+                }
+                err = sem_analyzer_close_node(analyzer);
+                depth--;
+                break;
+
+            case LEX_COMMENT:
+                if (depth > 0) {
+                    syntaxer->state = SYN_ERR;
+                    return -1;
+                }
+                break;
+
+            case LEX_DELIM:
+                if (depth > 0) {
+                    syntaxer->state = SYN_ERR;
+                    return -1;
+                }
+                err = sem_analyzer_close_node(analyzer);
+                syntaxer->state = SYN_START;
+                break;
 
-        default:
+            default:
+                err = sem_analyzer_add_leaf(analyzer, sem_actions[lex]);
+                break;
+        }
+        if (err) {
             return -1;
-            break;
+        }
     }
 
-    return 0;
+    syntaxer->state = SYN_ERR;
+    return -1;
 }
 
 int8_t
@@ -323,40 +202,24 @@ sem_analyzer_process(struct sem_analyzer *analyzer)
     struct lex_parser *lexer = analyzer->lexer;
     struct syn_parser *syntaxer = analyzer->syntaxer;
 
-    enum syn_state cur_state = syn_parser_cur_state(syntaxer);
-    if (cur_state != SYN_START) {
+    if (syn_parser_cur_state(syntaxer) != SYN_START) {
         return -1;
     }
 
-    while (cur_state != SYN_END) {
-        if (syntaxer->need_next_lex) {
-            int8_t err = lex_parser_read(lexer);
-            if (err) {
-                return -1;
-            }
-        }
-        enum lex_terminal cur_lex = lexer->next;
+    uint64_t pos = lexer->pos;
+    int8_t err = sem_analyzer_parse(analyzer, &pos);
 
-        int8_t err = sem_analyzer_process_node(analyzer, cur_state, cur_lex);
-        if (err) {
-            return -1;
-        }
-
-        err = syn_parser_process_lex(syntaxer, cur_lex);
-        if (err) {
-            return -1;
-        }
-        cur_state = syn_parser_cur_state(syntaxer);
+    // The errors are reported at the token the parse stopped at.
+    if (lex_parser_seek(lexer, pos)) {
+        return -1;
+    }
+    if (err) {
+        return -1;
     }
 
-    return 0;
+    return sem_analyzer_close_node(analyzer);
 }
 
-struct sem_node_depth {
-    struct sem_node *node;
-    int32_t depth;
-};
-
 int8_t
 sem_analyzer_tree_print(struct sem_analyzer *analyzer)
 {
@@ -364,47 +227,32 @@ sem_analyzer_tree_print(struct sem_analyzer *analyzer)
         return -1;
     }
 
-    int32_t stack_max_size = 32;
+    struct sem_tree *tree = &analyzer->tree;
 
-    struct sem_node_depth *stack = calloc(stack_max_size, sizeof(*stack));
-    if (!stack) {
+    // Ends of the subtrees the current node is in, their number is its depth.
+    int32_t *ends = calloc(tree->nodes_num + 1, sizeof(*ends));
+    if (!ends) {
         return -1;
     }
+    int32_t depth = 0;
 
-    stack[0].node = &analyzer->tree;
-    int32_t stack_len = 1;
-
-    while (stack_len > 0) {
-        struct sem_node_depth cur_elem = stack[stack_len - 1];
-        stack_len--;
+    for (int32_t i = 0; i < tree->nodes_num; i++) {
+        while (depth > 0 && ends[depth - 1] <= i) {
+            depth--;
+        }
 
-        for (int32_t i = 0; i < cur_elem.depth - 1; i++) {
+        for (int32_t j = 0; j < depth - 1; j++) {
             printf("    ");
         }
-        if (cur_elem.depth > 0) {
+        if (depth > 0) {
             printf("└-- ");
         }
-        printf("%d\n", (int) cur_elem.node->type);
-
-        for (int32_t i = 0; i < cur_elem.node->leaves_num; i++) {
-            struct sem_node_depth new_elem = {0};
-            new_elem.node = &cur_elem.node->leaves[i];
-            new_elem.depth = cur_elem.depth + 1;
-
-            stack_len++;
-            if (stack_len >= stack_max_size) {
-                stack_max_size *= 2;
-                stack = realloc(stack, stack_max_size * sizeof(*stack));
-                if (!stack) {
-                    return -1;
-                }
-            }
+        printf("%d\n", (int) tree->nodes[i].type);
 
-            stack[stack_len - 1] = new_elem;
-        }
+        ends[depth++] = sem_tree_next(tree, i);
     }
 
-    free(stack);
+    free(ends);
 
     return 0;
 }
@@ -0,0 +1 @@
+++++++++++++++++++++++++++++++++++++++++++++++++++.[-]>,<++++++++++++++++++++++++++++++++++++++++++++++++++. Prints 2 ahead of time then reads a byte and prints 2 again from the zeroed cell
@@ -0,0 +1,2 @@
+v:                         Calls the loop below at the left edge of a fresh tape
+[<->-]+++++++[>+++++++<-]>. Skipped so the cell left of the head stays untouched and 1 is printed
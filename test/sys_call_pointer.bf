@@ -0,0 +1,10 @@
+++++++++++[>++++++++++<-]>++++++++++++++++++++++[[->>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>-]>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++>++>>+>>+>++++++++++++++++<<<<<<%++++++++++++++++++++++++++++++++++++++++++++++++.  Call clock gettime with the block at cell 12281 and print 0 on success
+ Every line is a Brainfunction, only the first one runs.
+ cell12281  228  syscall number (clock gettime)
+ cell12282    2  argument count
+ cell12283    0  first argument type (normal)
+ cell12284    1  first argument length in cells
+ cell12285    0  first argument (realtime clock)
+ cell12286    1  second argument type (pointer)
+ cell12287   16  second argument length in cells
+ cell12288       second argument (the time), past the tape made accessible up front
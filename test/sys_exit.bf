@@ -1,16 +1,7 @@
-++++++[>++++++++++<-]>  Write code 60 (sys exit) in cell1
-
->                       move to cell2
-+                       Write argument count of 1 to cell2
-
->                       move to cell3
- (leave 0)              Write first arg type as normal
-
->                       move to cell4
-+                       Write first arg cell length of 1 to cell3
-
->                       move to cell5
-+++                     Write exit code 3 in cell4
-
-<<<<                    move back to cell1
-%                       Call kernel
\ No newline at end of file
+++++++[>++++++++++<-]>>+>>+>+++<<<<%  Call kernel with the block at cell1
+ Every line is a Brainfunction, only the first one runs.
+ cell1  60  syscall number (sys exit)
+ cell2   1  argument count
+ cell3   0  first argument type (normal)
+ cell4   1  first argument length in cells
+ cell5   3  first argument (exit code 3)